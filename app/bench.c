@@ -0,0 +1,685 @@
+// SPDX-License-Identifier: GPL-2.0
+// Copyright (C) 2004-2023 Sam Demeulemeester
+//
+// ------------------------
+//
+// Memory benchmarks run on all the enabled CPU cores at once.
+//
+// The bandwidth benchmark follows the STREAM methodology: each core works on
+// its own set of three arrays, which together are much larger than the last
+// level cache, and the best of several runs is reported. Bytes are counted
+// as in STREAM, i.e. without the extra reads caused by write-allocation.
+//
+// The latency benchmark chases pointers through a random permutation of the
+// cache lines in a buffer sized for each level of the memory hierarchy. The
+// lines are shuffled within each large (2MB) page, and the pages are visited
+// in turn, so that TLB misses do not inflate the result and the hardware
+// prefetchers cannot predict the next line.
+//
+// On NUMA systems, the bandwidth (Triad) and latency kernels are also run
+// from the CPUs of each node against a buffer in the memory of each node.
+// A node whose local figures fall well short of the others, or a pair of
+// nodes whose remote figures (relative to the local figures of the memory
+// node) fall well short of the other pairs, is flagged as an outlier.
+//
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "cpuinfo.h"
+#include "heap.h"
+#include "memctrl.h"
+#include "memsize.h"
+#include "smp.h"
+#include "tsc.h"
+#include "vmem.h"
+
+#include "barrier.h"
+
+#include "config.h"
+#include "display.h"
+#include "test.h"
+
+#include "bench.h"
+
+//------------------------------------------------------------------------------
+// Constants
+//------------------------------------------------------------------------------
+
+#define STREAM_NTIMES       4
+
+#define STREAM_SCALAR       3
+
+#define STREAM_MIN_ARRAY    SIZE_C(64,KB)
+#define STREAM_DEF_CACHE    4096    // in KB, used when the cache size is unknown
+
+#define LATENCY_STRIDE      64      // the cache line size
+#define LATENCY_LOADS       (1 << 20)
+
+#define LATENCY_MIN_DRAM    SIZE_C(64,MB)
+
+#define NUMA_BW_SIZE        SIZE_C(192,MB)
+#define NUMA_LATENCY_SIZE   SIZE_C(64,MB)
+#define NUMA_BUF_PAGES      ((NUMA_BW_SIZE + NUMA_LATENCY_SIZE) >> PAGE_SHIFT)
+
+#define NUMA_MIN_PAGE       (SIZE_C(16,MB) >> PAGE_SHIFT)
+
+#define NUMA_MIN_LOADS      (1 << 14)   // per CPU, when the loads are shared between many CPUs
+
+#define NUMA_OUTLIER_PCT    75      // flag figures worse than 75% of the typical value
+
+//------------------------------------------------------------------------------
+// Private Variables
+//------------------------------------------------------------------------------
+
+static const char *kernel_name[NUM_STREAM_KERNELS] = {
+    " Copy", "Scale", "  Add", "Triad", " Read", "Write"
+};
+
+// The number of words of each array read or written per element.
+static const int kernel_words[NUM_STREAM_KERNELS] = { 2, 2, 3, 3, 1, 1 };
+
+static uintptr_t    stream_base  = 0;
+static size_t       array_words  = 0;
+
+static uint64_t     core_cycles[MAX_CPUS];
+
+static volatile uintptr_t read_sink[MAX_CPUS];
+
+static const char *level_name[NUM_LATENCY_LEVELS] = {
+    "   L1", "   L2", "   L3", " DRAM"
+};
+
+static int          node_cpus[MAX_NUMA_NODES];
+static int          node_rank[MAX_CPUS];
+
+static uintptr_t    numa_buf_page[MAX_NUMA_NODES];
+static uintptr_t    *numa_chain   = NULL;
+
+static uintptr_t    *numa_chain_pos = NULL;
+static uint64_t     numa_chain_cycles = 0;
+
+//------------------------------------------------------------------------------
+// Public Variables
+//------------------------------------------------------------------------------
+
+uint32_t stream_bw[NUM_STREAM_KERNELS];
+
+uint32_t stream_core_bw[MAX_CPUS][NUM_STREAM_KERNELS];
+
+uint32_t load_latency[NUM_LATENCY_LEVELS];
+
+uint32_t numa_bw[MAX_NUMA_NODES][MAX_NUMA_NODES];
+
+uint32_t numa_latency[MAX_NUMA_NODES][MAX_NUMA_NODES];
+
+//------------------------------------------------------------------------------
+// Private Functions
+//------------------------------------------------------------------------------
+
+static uint32_t bandwidth(uint64_t bytes, uint64_t cycles)
+{
+    if (cycles == 0) {
+        return 0;
+    }
+    return (bytes * clks_per_msec) / cycles;
+}
+
+static void run_kernel(int kernel, int my_cpu, uintptr_t *a, uintptr_t *b, uintptr_t *c, size_t n)
+{
+    uintptr_t sum = 0;
+
+    switch (kernel) {
+      case STREAM_COPY:
+        for (size_t i = 0; i < n; i++) {
+            c[i] = a[i];
+        }
+        break;
+      case STREAM_SCALE:
+        for (size_t i = 0; i < n; i++) {
+            b[i] = STREAM_SCALAR * c[i];
+        }
+        break;
+      case STREAM_ADD:
+        for (size_t i = 0; i < n; i++) {
+            c[i] = a[i] + b[i];
+        }
+        break;
+      case STREAM_TRIAD:
+        for (size_t i = 0; i < n; i++) {
+            a[i] = b[i] + STREAM_SCALAR * c[i];
+        }
+        break;
+      case STREAM_READ:
+        for (size_t i = 0; i < n; i++) {
+            sum += a[i];
+        }
+        read_sink[my_cpu] = sum;
+        break;
+      case STREAM_WRITE:
+        for (size_t i = 0; i < n; i++) {
+            c[i] = i;
+        }
+        break;
+      default:
+        break;
+    }
+}
+
+static bool alloc_arrays(void)
+{
+    size_t cache_size = l3_cache ? l3_cache : l2_cache ? l2_cache : STREAM_DEF_CACHE;
+
+    // STREAM requires each array to be at least four times the size of the
+    // last level cache. The arrays are shared out between the cores.
+    size_t array_size = ((size_t)cache_size * 1024 * 4) / num_enabled_cpus;
+    array_size = (array_size + PAGE_SIZE - 1) & ~(size_t)(PAGE_SIZE - 1);
+    if (array_size < STREAM_MIN_ARRAY) {
+        array_size = STREAM_MIN_ARRAY;
+    }
+
+    while (array_size >= STREAM_MIN_ARRAY) {
+        stream_base = heap_alloc(HEAP_TYPE_HM_1, 3 * array_size * num_enabled_cpus, PAGE_SIZE);
+        if (stream_base != 0) {
+            array_words = array_size / sizeof(uintptr_t);
+            return true;
+        }
+        array_size /= 2;
+    }
+    array_words = 0;
+    return false;
+}
+
+static uintptr_t random_next(uintptr_t state)
+{
+    // Xorshift, as used for the random patterns in the memory tests.
+#ifdef __x86_64__
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+#else
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+#endif
+    return state;
+}
+
+static uintptr_t *line_ptr(uintptr_t addr, size_t line)
+{
+    return (uintptr_t *)(addr + line * LATENCY_STRIDE);
+}
+
+// Links the cache lines in [addr, addr + size) into a single chain, visiting
+// the lines of each large page in a random order, and returns the first line.
+static uintptr_t *build_chain(uintptr_t addr, size_t size)
+{
+    size_t set_lines = VM_PAGE_SIZE / LATENCY_STRIDE;
+    size_t num_lines = size / LATENCY_STRIDE;
+    uintptr_t state = 0x2545f491;
+
+    uintptr_t *first = NULL;
+    uintptr_t *last  = NULL;
+    for (size_t set = 0; set < num_lines; set += set_lines) {
+        size_t n = num_lines - set < set_lines ? num_lines - set : set_lines;
+
+        // Use the second word of each line to hold the visiting order while
+        // it is shuffled (Fisher-Yates).
+        for (size_t i = 0; i < n; i++) {
+            line_ptr(addr, set + i)[1] = set + i;
+        }
+        for (size_t i = n - 1; i > 0; i--) {
+            state = random_next(state);
+            size_t j = state % (i + 1);
+            uintptr_t tmp = line_ptr(addr, set + i)[1];
+            line_ptr(addr, set + i)[1] = line_ptr(addr, set + j)[1];
+            line_ptr(addr, set + j)[1] = tmp;
+        }
+        for (size_t i = 0; i < n; i++) {
+            uintptr_t *line = line_ptr(addr, line_ptr(addr, set + i)[1]);
+            if (last != NULL) {
+                *last = (uintptr_t)line;
+            } else {
+                first = line;
+            }
+            last = line;
+        }
+    }
+    *last = (uintptr_t)first;
+
+    return first;
+}
+
+static uintptr_t *chase(uintptr_t *p, size_t loads)
+{
+    for (size_t i = 0; i < loads; i += 8) {
+        p = (uintptr_t *)*p;
+        p = (uintptr_t *)*p;
+        p = (uintptr_t *)*p;
+        p = (uintptr_t *)*p;
+        p = (uintptr_t *)*p;
+        p = (uintptr_t *)*p;
+        p = (uintptr_t *)*p;
+        p = (uintptr_t *)*p;
+    }
+    return p;
+}
+
+static uint32_t time_chain(uintptr_t *p, size_t size)
+{
+    // Warm up the caches and TLBs by walking the whole chain once.
+    p = chase(p, size / LATENCY_STRIDE);
+
+    uint64_t start_time = get_tsc();
+    p = chase(p, LATENCY_LOADS);
+    uint64_t run_time = get_tsc() - start_time;
+
+    read_sink[0] = (uintptr_t)p;
+
+    // Convert cycles per load to picoseconds.
+    return (run_time * 1000000000) / ((uint64_t)LATENCY_LOADS * clks_per_msec);
+}
+
+// Returns the first page of a free region of physical memory in the given
+// NUMA node that is large enough for the NUMA benchmark and that lies within
+// a single virtual memory window, or 0 if there is none.
+static uintptr_t find_node_buffer(int node)
+{
+    uintptr_t program_start = (uintptr_t)_start >> PAGE_SHIFT;
+    uintptr_t program_end   = ((uintptr_t)_end + PAGE_SIZE - 1) >> PAGE_SHIFT;
+
+    for (int i = 0; i < num_numa_ranges; i++) {
+        if (numa_ranges[i].node != node) {
+            continue;
+        }
+        for (int j = 0; j < pm_map_size; j++) {
+            uintptr_t start = numa_ranges[i].start > pm_map[j].start ? numa_ranges[i].start : pm_map[j].start;
+            uintptr_t end   = numa_ranges[i].end   < pm_map[j].end   ? numa_ranges[i].end   : pm_map[j].end;
+            if (start < NUMA_MIN_PAGE) {
+                start = NUMA_MIN_PAGE;
+            }
+            while (start + NUMA_BUF_PAGES <= end) {
+                if (start < program_end && start + NUMA_BUF_PAGES > program_start) {
+                    start = program_end;
+                    continue;
+                }
+                uintptr_t window_end = start < VM_PINNED_SIZE ? VM_PINNED_SIZE
+                                     : (start / VM_WINDOW_SIZE + 1) * VM_WINDOW_SIZE;
+                if (start + NUMA_BUF_PAGES <= window_end) {
+                    return start;
+                }
+                start = window_end;
+            }
+        }
+    }
+    return 0;
+}
+
+static bool is_outlier(uint32_t value, uint32_t typical, bool higher_is_worse)
+{
+    if (higher_is_worse) {
+        return (uint64_t)value * NUMA_OUTLIER_PCT > (uint64_t)typical * 100;
+    }
+    return (uint64_t)value * 100 < (uint64_t)typical * NUMA_OUTLIER_PCT;
+}
+
+static void display_numa_matrix(const char *title, uint32_t matrix[MAX_NUMA_NODES][MAX_NUMA_NODES], bool is_latency)
+{
+    // Determine the typical local figure, and the typical ratio of each
+    // remote figure to the local figure of the memory node.
+    uint64_t local_sum = 0, ratio_sum = 0;
+    int local_count = 0, ratio_count = 0;
+    for (int i = 0; i < num_numa_nodes; i++) {
+        if (node_cpus[i] == 0) continue;
+        for (int j = 0; j < num_numa_nodes; j++) {
+            if (matrix[i][j] == 0 || matrix[j][j] == 0) continue;
+            if (i == j) {
+                local_sum += matrix[i][j];
+                local_count++;
+            } else {
+                ratio_sum += ((uint64_t)matrix[i][j] * 1000) / matrix[j][j];
+                ratio_count++;
+            }
+        }
+    }
+    uint32_t local_typical = local_count ? local_sum / local_count : 0;
+    uint32_t ratio_typical = ratio_count ? ratio_sum / ratio_count : 0;
+
+    scroll();
+    display_scrolled_message(0, "%s", title);
+    for (int j = 0; j < num_numa_nodes; j++) {
+        display_scrolled_message(23 + 7 * j, "Mem %i", j);
+    }
+    for (int i = 0; i < num_numa_nodes; i++) {
+        if (node_cpus[i] == 0) continue;
+        scroll();
+        display_scrolled_message(0, "  CPU node %i", i);
+        for (int j = 0; j < num_numa_nodes; j++) {
+            int col = 21 + 7 * j;
+            if (matrix[i][j] == 0) {
+                display_scrolled_message(col + 4, "N/A");
+                continue;
+            }
+            uint32_t tenths = is_latency ? (matrix[i][j] + 50) / 100 : matrix[i][j] / 100000;
+            display_scrolled_message(col, "%4u.%u", (uintptr_t)(tenths / 10), (uintptr_t)(tenths % 10));
+
+            bool outlier;
+            if (i == j) {
+                outlier = is_outlier(matrix[i][j], local_typical, is_latency);
+            } else {
+                uint32_t ratio = matrix[j][j] ? ((uint64_t)matrix[i][j] * 1000) / matrix[j][j] : 0;
+                outlier = is_outlier(ratio, ratio_typical, is_latency);
+            }
+            if (outlier) {
+                display_scrolled_message(col + 6, "*");
+            }
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+// Public Functions
+//------------------------------------------------------------------------------
+
+bool stream_bench(int my_cpu, barrier_t *barrier)
+{
+    uintptr_t heap_top = 0;
+
+    // The arrays may lie in the range the memory tests and the NUMA benchmark
+    // remap, so restore its direct mapping when the benchmark is rerun.
+    map_window(VM_PINNED_SIZE);
+
+    if (my_cpu == 0) {
+        heap_top = heap_mark(HEAP_TYPE_HM_1);
+        alloc_arrays();
+    }
+    barrier_spin_wait(barrier);
+
+    if (array_words == 0 || clks_per_msec == 0) {
+        return false;
+    }
+
+    size_t n = array_words;
+    uintptr_t *a = (uintptr_t *)stream_base + 3 * n * chunk_index[my_cpu];
+    uintptr_t *b = a + n;
+    uintptr_t *c = b + n;
+
+    for (size_t i = 0; i < n; i++) {
+        a[i] = 1;
+        b[i] = 2;
+        c[i] = 0;
+    }
+
+    for (int kernel = 0; kernel < NUM_STREAM_KERNELS; kernel++) {
+        uint64_t best_cycles = UINT64_MAX;
+        uint64_t best_total  = UINT64_MAX;
+        for (int run = 0; run < STREAM_NTIMES; run++) {
+            barrier_spin_wait(barrier);
+            uint64_t start_time = get_tsc();
+            run_kernel(kernel, my_cpu, a, b, c, n);
+            core_cycles[my_cpu] = get_tsc() - start_time;
+            barrier_spin_wait(barrier);
+
+            if (core_cycles[my_cpu] < best_cycles) {
+                best_cycles = core_cycles[my_cpu];
+            }
+            if (my_cpu == 0) {
+                // The aggregate time is that of the slowest core.
+                uint64_t total_cycles = 0;
+                for (int cpu = 0; cpu < num_available_cpus; cpu++) {
+                    if (cpu_state[cpu] != CPU_STATE_DISABLED && core_cycles[cpu] > total_cycles) {
+                        total_cycles = core_cycles[cpu];
+                    }
+                }
+                if (total_cycles < best_total) {
+                    best_total = total_cycles;
+                }
+            }
+        }
+        uint64_t bytes = (uint64_t)kernel_words[kernel] * n * sizeof(uintptr_t);
+        stream_core_bw[my_cpu][kernel] = bandwidth(bytes, best_cycles);
+        if (my_cpu == 0) {
+            stream_bw[kernel] = bandwidth(bytes * num_enabled_cpus, best_total);
+        }
+    }
+    barrier_spin_wait(barrier);
+
+    if (my_cpu == 0) {
+        heap_rewind(HEAP_TYPE_HM_1, heap_top);
+        array_words = 0;
+    }
+    return true;
+}
+
+uint32_t measure_latency(uintptr_t addr, size_t size)
+{
+    if (clks_per_msec == 0 || size < 2 * LATENCY_STRIDE) {
+        return 0;
+    }
+
+    return time_chain(build_chain(addr, size), size);
+}
+
+bool latency_bench(void)
+{
+    uintptr_t heap_top = heap_mark(HEAP_TYPE_HM_1);
+
+    // The NUMA benchmark may have left another window mapped where the buffer
+    // lies, so restore the direct mapping first.
+    map_window(VM_PINNED_SIZE);
+
+    size_t dram_size = (size_t)l3_cache * 1024 * 4;
+    if (dram_size < LATENCY_MIN_DRAM) {
+        dram_size = LATENCY_MIN_DRAM;
+    }
+    uintptr_t buffer = 0;
+    while (buffer == 0 && dram_size >= LATENCY_MIN_DRAM / 8) {
+        buffer = heap_alloc(HEAP_TYPE_HM_1, dram_size, VM_PAGE_SIZE);
+        if (buffer == 0) {
+            dram_size /= 2;
+        }
+    }
+    if (buffer == 0) {
+        return false;
+    }
+
+    // Use half of each cache, so the buffer is well clear of the next
+    // smaller level and not evicted from this one.
+    load_latency[LATENCY_L1]   = l1_cache ? measure_latency(buffer, (size_t)l1_cache * 1024 / 2) : 0;
+    load_latency[LATENCY_L2]   = l2_cache ? measure_latency(buffer, (size_t)l2_cache * 1024 / 2) : 0;
+    load_latency[LATENCY_L3]   = l3_cache ? measure_latency(buffer, (size_t)l3_cache * 1024 / 2) : 0;
+    load_latency[LATENCY_DRAM] = measure_latency(buffer, dram_size);
+
+    heap_rewind(HEAP_TYPE_HM_1, heap_top);
+
+    return true;
+}
+
+bool numa_bench(int my_cpu, barrier_t *barrier)
+{
+    if (num_numa_nodes < 2 || clks_per_msec == 0) {
+        return false;
+    }
+
+    int my_node = smp_cpu_numa_node(my_cpu);
+
+    if (my_cpu == 0) {
+        for (int node = 0; node < MAX_NUMA_NODES; node++) {
+            node_cpus[node] = 0;
+            for (int j = 0; j < MAX_NUMA_NODES; j++) {
+                numa_bw[node][j]      = 0;
+                numa_latency[node][j] = 0;
+            }
+        }
+        for (int cpu = 0; cpu < num_available_cpus; cpu++) {
+            if (cpu_state[cpu] == CPU_STATE_DISABLED) continue;
+            int node = smp_cpu_numa_node(cpu);
+            node_rank[cpu] = node_cpus[node]++;
+        }
+        for (int node = 0; node < num_numa_nodes; node++) {
+            numa_buf_page[node] = find_node_buffer(node);
+        }
+    }
+
+    for (int mem_node = 0; mem_node < num_numa_nodes; mem_node++) {
+        // CPU 0 only changes this node's entry before the barrier and every
+        // CPU reads it after, so all the CPUs skip the same nodes and pass
+        // the same number of barriers.
+        if (my_cpu == 0 && numa_buf_page[mem_node] != 0) {
+            if (map_window(numa_buf_page[mem_node])) {
+                uintptr_t latency_buf = (uintptr_t)first_word_mapping(numa_buf_page[mem_node]) + NUMA_BW_SIZE;
+                numa_chain = build_chain(latency_buf, NUMA_LATENCY_SIZE);
+            } else {
+                numa_buf_page[mem_node] = 0;
+            }
+        }
+        barrier_spin_wait(barrier);
+
+        uintptr_t buf_page = numa_buf_page[mem_node];
+        if (buf_page == 0) {
+            continue;
+        }
+        map_window(buf_page);
+        uintptr_t *buffer = first_word_mapping(buf_page);
+
+        for (int cpu_node = 0; cpu_node < num_numa_nodes; cpu_node++) {
+            if (node_cpus[cpu_node] == 0) {
+                continue;
+            }
+            bool active = (my_node == cpu_node);
+
+            size_t n = NUMA_BW_SIZE / (3 * sizeof(uintptr_t) * node_cpus[cpu_node]);
+            uintptr_t *a = buffer + 3 * n * node_rank[my_cpu];
+            uintptr_t *b = a + n;
+            uintptr_t *c = b + n;
+
+            core_cycles[my_cpu] = 0;
+            if (active) {
+                for (size_t i = 0; i < n; i++) {
+                    b[i] = 2;
+                    c[i] = 1;
+                }
+            }
+            if (my_cpu == 0) {
+                numa_chain_pos    = numa_chain;
+                numa_chain_cycles = 0;
+            }
+            barrier_spin_wait(barrier);
+
+            if (active) {
+                uint64_t start_time = get_tsc();
+                run_kernel(STREAM_TRIAD, my_cpu, a, b, c, n);
+                core_cycles[my_cpu] = get_tsc() - start_time;
+            }
+            barrier_spin_wait(barrier);
+
+            if (my_cpu == 0) {
+                uint64_t total_cycles = 0;
+                for (int cpu = 0; cpu < num_available_cpus; cpu++) {
+                    if (core_cycles[cpu] > total_cycles) {
+                        total_cycles = core_cycles[cpu];
+                    }
+                }
+                uint64_t bytes = (uint64_t)kernel_words[STREAM_TRIAD] * n * sizeof(uintptr_t) * node_cpus[cpu_node];
+                numa_bw[cpu_node][mem_node] = bandwidth(bytes, total_cycles);
+            }
+
+            // Each CPU of the node in turn takes its share of the loads,
+            // continuing along the chain from where the last one stopped, so
+            // no CPU finds lines left in a shared cache by another.
+            size_t loads = LATENCY_LOADS / node_cpus[cpu_node];
+            if (loads < NUMA_MIN_LOADS) {
+                loads = NUMA_MIN_LOADS;
+            }
+            loads &= ~(size_t)7;    // chase() loads 8 at a time
+            for (int rank = 0; rank < node_cpus[cpu_node]; rank++) {
+                if (active && node_rank[my_cpu] == rank) {
+                    uint64_t start_time = get_tsc();
+                    numa_chain_pos = chase(numa_chain_pos, loads);
+                    numa_chain_cycles += get_tsc() - start_time;
+                }
+                barrier_spin_wait(barrier);
+            }
+            if (my_cpu == 0) {
+                // Convert the mean cycles per load to picoseconds.
+                uint64_t total_loads = (uint64_t)loads * node_cpus[cpu_node];
+                numa_latency[cpu_node][mem_node] = (numa_chain_cycles * 1000000000) / (total_loads * clks_per_msec);
+            }
+        }
+    }
+    return true;
+}
+
+void display_stream_results(void)
+{
+    scroll();
+    display_scrolled_message(0, "Memory bandwidth (GB/s)");
+    for (int kernel = 0; kernel < NUM_STREAM_KERNELS; kernel++) {
+        display_scrolled_message(24 + 8 * kernel, "%s", kernel_name[kernel]);
+    }
+    for (int cpu = 0; cpu <= num_available_cpus; cpu++) {
+        const uint32_t *bw = stream_bw;
+        if (cpu < num_available_cpus) {
+            if (cpu_state[cpu] == CPU_STATE_DISABLED) {
+                continue;
+            }
+            bw = stream_core_bw[cpu];
+        }
+        scroll();
+        if (cpu < num_available_cpus) {
+            display_scrolled_message(0, "  CPU %i", cpu);
+        } else {
+            display_scrolled_message(0, "  All CPUs");
+        }
+        for (int kernel = 0; kernel < NUM_STREAM_KERNELS; kernel++) {
+            uint32_t mb_per_sec = bw[kernel] / 1000;
+            display_scrolled_message(22 + 8 * kernel, "%4u.%02u", (uintptr_t)(mb_per_sec / 1000),
+                                                              (uintptr_t)((mb_per_sec % 1000) / 10));
+        }
+    }
+
+    uint16_t width, freq;
+    uint32_t peak_bw = memctrl_peak_bandwidth(&width, &freq);
+    if (peak_bw == 0) {
+        return;
+    }
+    scroll();
+    display_scrolled_message(0, "  %% of peak");
+    for (int kernel = 0; kernel < NUM_STREAM_KERNELS; kernel++) {
+        uintptr_t pct = ((uint64_t)stream_bw[kernel] * 100) / peak_bw;
+        display_scrolled_message(22 + 8 * kernel, "%6u%%", pct);
+    }
+    uint32_t mb_per_sec = peak_bw / 1000;
+    scroll();
+    display_scrolled_message(0, "  Theoretical peak %u.%02u GB/s (%u-bit at %u MT/s)",
+                             (uintptr_t)(mb_per_sec / 1000), (uintptr_t)((mb_per_sec % 1000) / 10),
+                             (uintptr_t)width, (uintptr_t)freq);
+}
+
+void display_latency_results(void)
+{
+    scroll();
+    display_scrolled_message(0, "Load latency (ns)");
+    for (int level = 0; level < NUM_LATENCY_LEVELS; level++) {
+        display_scrolled_message(24 + 8 * level, "%s", level_name[level]);
+    }
+    scroll();
+    display_scrolled_message(0, "  CPU %i", smp_my_cpu_num());
+    for (int level = 0; level < NUM_LATENCY_LEVELS; level++) {
+        if (load_latency[level] == 0) {
+            display_scrolled_message(26 + 8 * level, "N/A");
+            continue;
+        }
+        uint32_t tenths = (load_latency[level] + 50) / 100;
+        display_scrolled_message(22 + 8 * level, "%5u.%u", (uintptr_t)(tenths / 10), (uintptr_t)(tenths % 10));
+    }
+}
+
+void display_numa_results(void)
+{
+    display_numa_matrix("NUMA bandwidth (GB/s)", numa_bw, false);
+    display_numa_matrix("NUMA latency (ns)", numa_latency, true);
+    scroll();
+    display_scrolled_message(0, "  * = outlier, more than %i%% worse than typical for local or remote access",
+                             100 - NUMA_OUTLIER_PCT);
+}
@@ -0,0 +1,125 @@
+// SPDX-License-Identifier: GPL-2.0
+#ifndef BENCH_H
+#define BENCH_H
+/**
+ * \file
+ *
+ * Provides the memory benchmarks that are run on all the enabled CPU cores
+ * before testing starts.
+ *
+ *//*
+ * Copyright (C) 2004-2023 Sam Demeulemeester.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "smp.h"
+
+#include "barrier.h"
+
+/**
+ * The STREAM-style bandwidth benchmark kernels.
+ */
+typedef enum {
+    STREAM_COPY,
+    STREAM_SCALE,
+    STREAM_ADD,
+    STREAM_TRIAD,
+    STREAM_READ,
+    STREAM_WRITE,
+    NUM_STREAM_KERNELS
+} stream_kernel_t;
+
+/**
+ * The memory levels measured by the latency benchmark.
+ */
+typedef enum {
+    LATENCY_L1,
+    LATENCY_L2,
+    LATENCY_L3,
+    LATENCY_DRAM,
+    NUM_LATENCY_LEVELS
+} latency_level_t;
+
+/**
+ * The aggregate bandwidth (in kB/s) measured for each kernel when run on
+ * all the enabled CPU cores at once.
+ */
+extern uint32_t stream_bw[NUM_STREAM_KERNELS];
+
+/**
+ * The bandwidth (in kB/s) measured by each CPU core for each kernel while
+ * all the enabled CPU cores were running that kernel.
+ */
+extern uint32_t stream_core_bw[MAX_CPUS][NUM_STREAM_KERNELS];
+
+/**
+ * The average load-to-use latency (in ps) measured for each memory level,
+ * or 0 if that level was not measured.
+ */
+extern uint32_t load_latency[NUM_LATENCY_LEVELS];
+
+/**
+ * The aggregate Triad bandwidth (in kB/s) measured by the CPUs of each NUMA
+ * node (first index) against the memory of each NUMA node (second index),
+ * or 0 if that combination was not measured.
+ */
+extern uint32_t numa_bw[MAX_NUMA_NODES][MAX_NUMA_NODES];
+
+/**
+ * The load latency (in ps) measured by the first CPU of each NUMA node
+ * (first index) against the memory of each NUMA node (second index), or 0
+ * if that combination was not measured.
+ */
+extern uint32_t numa_latency[MAX_NUMA_NODES][MAX_NUMA_NODES];
+
+/**
+ * Runs the STREAM-style bandwidth benchmark. Must be called by all the
+ * enabled CPU cores, with a barrier initialised for that number of threads.
+ * Returns false if there was insufficient memory to run the benchmark.
+ */
+bool stream_bench(int my_cpu, barrier_t *barrier);
+
+/**
+ * Measures the average latency (in ps) of dependent loads that follow a
+ * random chain of cache lines through size bytes of memory starting at the
+ * (mapped) address addr. Returns 0 if the TSC frequency is unknown.
+ */
+uint32_t measure_latency(uintptr_t addr, size_t size);
+
+/**
+ * Runs the pointer-chasing latency benchmark on the calling CPU core for
+ * each level of the memory hierarchy. Returns false if there was
+ * insufficient memory to run the benchmark.
+ */
+bool latency_bench(void);
+
+/**
+ * Runs the bandwidth and latency kernels from all the CPUs of each NUMA
+ * node against the memory of each NUMA node. The latency is the mean over
+ * those CPUs. Must be called by all the enabled
+ * CPU cores, with a barrier initialised for that number of threads.
+ * Returns false if the system does not have multiple NUMA nodes.
+ */
+bool numa_bench(int my_cpu, barrier_t *barrier);
+
+/**
+ * Displays the aggregate and per-core results of the bandwidth benchmark
+ * in the scrolled message area.
+ */
+void display_stream_results(void);
+
+/**
+ * Displays the results of the latency benchmark in the scrolled message
+ * area.
+ */
+void display_latency_results(void);
+
+/**
+ * Displays the NUMA bandwidth and latency matrices in the scrolled message
+ * area, flagging outliers.
+ */
+void display_numa_results(void);
+
+#endif // BENCH_H
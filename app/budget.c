@@ -0,0 +1,268 @@
+// SPDX-License-Identifier: GPL-2.0
+// Copyright (C) 2004-2023 Sam Demeulemeester.
+//
+// The time taken by each test is estimated from the number of ticks it is
+// expected to take. Apart from the bit fade delay, each tick is one
+// sweep over a memory segment, so dividing by the number of ticks taken by
+// a single sweep over all the memory gives the number of sweeps the test
+// makes. Each sweep reads and writes every word, so the time taken is the
+// total bytes read and written divided by the measured copy bandwidth -
+// the aggregate bandwidth for the tests that run on all CPUs in parallel,
+// and the single core bandwidth for the others.
+//
+// Test 0 is the exception: it runs with the caches disabled and makes a few
+// thousand accesses per segment rather than sweeps, so it is estimated from
+// the number of accesses and the measured DRAM latency instead.
+//
+// The number of iterations of every test that takes an iteration count is
+// then scaled to fill the time left after the tests that don't and the bit
+// fade test, whose delay is kept as configured. If even a
+// single iteration of each test won't fit, only a sample of the memory is
+// tested, with the blocks not yet tested being chosen on each pass, so the
+// coverage grows over successive passes.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "cpuinfo.h"
+#include "memsize.h"
+#include "pmem.h"
+#include "vmem.h"
+
+#include "bench.h"
+#include "config.h"
+#include "display.h"
+#include "error.h"
+#include "sample.h"
+#include "test.h"
+
+#include "test_helper.h"
+#include "tests.h"
+
+#include "budget.h"
+
+//------------------------------------------------------------------------------
+// Constants
+//------------------------------------------------------------------------------
+
+#define NUM_ADDRESS_TESTS       3       // tests 0 to 2 don't take an iteration count
+#define BIT_FADE_TEST           10      // its iteration count is the fade delay in seconds
+#define BIT_FADE_DELAYS         2
+
+#define MAX_ITERATION_SCALE     4
+
+#define DEFAULT_DRAM_LATENCY    100000  // in ps, used if the benchmark was not run
+
+//------------------------------------------------------------------------------
+// Private Variables
+//------------------------------------------------------------------------------
+
+static bool         planned = false;
+
+static int          plan_iterations[NUM_TEST_PATTERNS];
+
+static int          test_coverage[NUM_TEST_PATTERNS];
+
+//------------------------------------------------------------------------------
+// Private Functions
+//------------------------------------------------------------------------------
+
+static uint64_t ticks_per_sweep(void)
+{
+    const uint64_t words_per_page = PAGE_SIZE / sizeof(testword_t);
+
+    // A tick is counted for each segment of each window, or for each
+    // SPIN_SIZE words of a larger segment.
+    uint64_t ticks = 0;
+    for (int i = 0; i < pm_map_size; i++) {
+        uintptr_t start = pm_map[i].start > pm_limit_lower ? pm_map[i].start : pm_limit_lower;
+        uintptr_t end   = pm_map[i].end   < pm_limit_upper ? pm_map[i].end   : pm_limit_upper;
+        while (start < end) {
+            uintptr_t window_end = (start / VM_WINDOW_SIZE + 1) * VM_WINDOW_SIZE;
+            uintptr_t piece_end  = window_end < end ? window_end : end;
+            ticks += ((piece_end - start) * words_per_page + SPIN_SIZE - 1) / SPIN_SIZE;
+            start = piece_end;
+        }
+    }
+    return ticks;
+}
+
+static uint64_t addr_walk_msec(void)
+{
+    // For each segment of each window, the walking ones test writes the first
+    // address and then writes the second address and reads back the first for
+    // each pair of address bits, once with each polarity.
+    uint64_t accesses = 0;
+    for (int i = 0; i < pm_map_size; i++) {
+        uintptr_t start = pm_map[i].start > pm_limit_lower ? pm_map[i].start : pm_limit_lower;
+        uintptr_t end   = pm_map[i].end   < pm_limit_upper ? pm_map[i].end   : pm_limit_upper;
+        while (start < end) {
+            uintptr_t window_end = (start / VM_WINDOW_SIZE + 1) * VM_WINDOW_SIZE;
+            uintptr_t piece_end  = window_end < end ? window_end : end;
+            uint64_t bytes = (uint64_t)(piece_end - start) << PAGE_SHIFT;
+            uint64_t bits = 0;
+            for (uint64_t mask = sizeof(testword_t); mask < bytes; mask <<= 1) {
+                bits++;
+            }
+            accesses += 2 * bits * (1 + 2 * bits);
+            start = piece_end;
+        }
+    }
+    uint64_t latency = load_latency[LATENCY_DRAM];
+    if (latency == 0) {
+        latency = DEFAULT_DRAM_LATENCY;
+    }
+    return (accesses * latency) / 1000000000;
+}
+
+static uint64_t bytes_per_msec(int test)
+{
+    // Both measurements are in bytes per ms, which the display shows as kB/s.
+    uint32_t bandwidth;
+    if (cpu_mode == PAR && test_list[test].cpu_mode == PAR) {
+        bandwidth = stream_bw[STREAM_COPY];
+    } else {
+        bandwidth = stream_core_bw[0][STREAM_COPY];
+    }
+    if (bandwidth == 0) {
+        // The benchmark was not run, so fall back to the startup measurement.
+        bandwidth = ram_speed;
+    }
+    return bandwidth;
+}
+
+static uint64_t estimate_msec(int test, uint64_t sweep_ticks)
+{
+    uint64_t bytes = (uint64_t)num_pages_to_test << PAGE_SHIFT;
+    uint64_t rate  = bytes_per_msec(test) * ticks_per_sweep();
+    if (rate == 0) {
+        return 0;
+    }
+    return (sweep_ticks * bytes * 2) / rate;
+}
+
+//------------------------------------------------------------------------------
+// Public Functions
+//------------------------------------------------------------------------------
+
+void budget_reset(void)
+{
+    planned = false;
+    sample_ratio = SAMPLE_FULL;
+}
+
+bool budget_plan(void)
+{
+    if (time_budget == 0 || planned || replay_test >= 0 || focus_mode) {
+        return false;
+    }
+    planned = true;
+
+    uint64_t budget_ms = ((uint64_t)time_budget * 60 * 1000) / (num_passes > 0 ? num_passes : 1);
+
+    uint64_t est_ms[NUM_TEST_PATTERNS];
+    uint64_t fixed_ms = 0;
+    uint64_t scaled_ms = 0;
+    uint64_t fade_ms = 0;
+    for (int test = 0; test < NUM_TEST_PATTERNS; test++) {
+        plan_iterations[test] = test_list[test].iterations;
+        est_ms[test] = 0;
+        if (!test_list[test].enabled) continue;
+
+        if (test == 0) {
+            est_ms[test] = addr_walk_msec();
+            fixed_ms += est_ms[test];
+            continue;
+        }
+
+        uint64_t sweep_ticks = ticks_per_test[FULL_PASS][test];
+        uint64_t delay_ms = 0;
+        if (test == BIT_FADE_TEST) {
+            uint64_t delay_ticks = BIT_FADE_DELAYS * test_list[test].iterations;
+            sweep_ticks = sweep_ticks > delay_ticks ? sweep_ticks - delay_ticks : 0;
+            delay_ms = delay_ticks * 1000;
+            fade_ms = delay_ms;
+        }
+        est_ms[test] = estimate_msec(test, sweep_ticks) + delay_ms;
+        if (test < NUM_ADDRESS_TESTS || test == BIT_FADE_TEST) {
+            fixed_ms  += est_ms[test];
+        } else {
+            scaled_ms += est_ms[test];
+        }
+    }
+    if (bytes_per_msec(0) == 0 || fixed_ms + scaled_ms == 0) {
+        // Keep the iterations, which the tick estimates have already used.
+        trace(0, "budget: no bandwidth measurement, not planning");
+        return false;
+    }
+
+    // Scale the iterations (in parts per thousand) to fill the time left.
+    uint64_t scale = MAX_ITERATION_SCALE * 1000;
+    if (scaled_ms > 0) {
+        scale = budget_ms > fixed_ms ? ((budget_ms - fixed_ms) * 1000) / scaled_ms : 0;
+        if (scale > MAX_ITERATION_SCALE * 1000) {
+            scale = MAX_ITERATION_SCALE * 1000;
+        }
+    }
+    uint64_t plan_ms = fixed_ms;
+    for (int test = NUM_ADDRESS_TESTS; test < NUM_TEST_PATTERNS; test++) {
+        if (test == BIT_FADE_TEST) continue;
+        int base = test_list[test].iterations;
+        int iterations = (base * scale) / 1000;
+        if (iterations < 1) {
+            iterations = 1;
+        }
+        plan_iterations[test] = iterations;
+        plan_ms += (est_ms[test] * iterations) / base;
+    }
+
+    // If that's not enough, only test a sample of the memory. Sampling doesn't
+    // shorten the bit fade delay.
+    sample_ratio = SAMPLE_FULL;
+    if (plan_ms > budget_ms) {
+        sample_ratio = budget_ms > fade_ms ? ((budget_ms - fade_ms) * SAMPLE_FULL) / (plan_ms - fade_ms) : 1;
+        if (sample_ratio < 1) {
+            sample_ratio = 1;
+        }
+    }
+    trace(0, "budget %ums per pass, estimate %ums, iterations x%i/1000, sample %i/1000",
+          (uintptr_t)budget_ms, (uintptr_t)plan_ms, (int)scale, sample_ratio);
+
+    return true;
+}
+
+int budget_iterations(int test, int iterations)
+{
+    return planned ? plan_iterations[test] : iterations;
+}
+
+void budget_end_test(void)
+{
+    test_coverage[test_num] = num_pages_to_test ? (test_pages_covered * SAMPLE_FULL) / num_pages_to_test : 0;
+}
+
+void budget_report(void)
+{
+    if (!planned || error_count > 0 || enable_trace || enable_profile) {
+        return;
+    }
+    clear_message_area();
+    display_pinned_message(0, 0, "Pass %i plan for a %i minute budget", pass_num, time_budget);
+    display_pinned_message(1, 0, "Test  Iterations  Coverage");
+    int row = 2;
+    for (int test = 0; test < NUM_TEST_PATTERNS; test++) {
+        if (!test_list[test].enabled) continue;
+        int coverage = test_coverage[test];
+        if (test < NUM_ADDRESS_TESTS) {
+            display_pinned_message(row, 0, "%4i           - %6i.%i%%", test, coverage / 10, coverage % 10);
+        } else {
+            display_pinned_message(row, 0, "%4i %10i %6i.%i%%", test, plan_iterations[test], coverage / 10, coverage % 10);
+        }
+        row++;
+    }
+    if (sample_ratio < SAMPLE_FULL) {
+        int coverage = sample_coverage();
+        display_pinned_message(row, 0, "%i.%i%% of the memory covered so far", coverage / 10, coverage % 10);
+    }
+}
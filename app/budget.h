@@ -0,0 +1,49 @@
+// SPDX-License-Identifier: GPL-2.0
+#ifndef BUDGET_H
+#define BUDGET_H
+/**
+ * \file
+ *
+ * Provides a test plan that fits each pass into a time budget, by scaling
+ * the number of iterations of each test and, if that is not enough, by
+ * testing only a sample of the memory.
+ *
+ *//*
+ * Copyright (C) 2004-2023 Sam Demeulemeester.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * Discards the current plan. Must be called whenever the configuration
+ * changes.
+ */
+void budget_reset(void);
+
+/**
+ * If a time budget was given and there is no current plan, makes a plan
+ * from the estimated tick counts and the measured memory bandwidth, and
+ * returns true. The caller must then estimate the tick counts again for the
+ * new plan. Otherwise returns false.
+ */
+bool budget_plan(void);
+
+/**
+ * Returns the number of iterations planned for the given test, or the
+ * given number of iterations if there is no current plan.
+ */
+int budget_iterations(int test, int iterations);
+
+/**
+ * Records the memory covered by the current test.
+ */
+void budget_end_test(void);
+
+/**
+ * If there is a current plan, displays the iterations and the memory
+ * coverage of each test in the pass just completed.
+ */
+void budget_report(void);
+
+#endif // BUDGET_H
@@ -97,13 +97,38 @@ bool            enable_trace       = false;
 
 bool            enable_sm          = true;
 bool            enable_bench       = true;
+bool            show_bench_results = false;
 bool            enable_mch_read    = true;
 
+bool            enable_focus       = false;
+
+bool            enable_quick_pass  = false;
+
+bool            enable_profile     = false;
+
+bool            enable_fixed_seed  = false;
+uint64_t        fixed_seed         = 0;
+
+int             num_inject_addrs   = 0;
+uint64_t        inject_addr[MAX_INJECT_ADDRS];
+uint64_t        inject_mask[MAX_INJECT_ADDRS];
+uint32_t        inject_rate        = 0;
+
+int             replay_test        = -1;
+int             replay_pass        = 0;
+uintptr_t       replay_start       = 0;
+uintptr_t       replay_end         = 0;
+
 bool            pause_at_start     = true;
 
 power_save_t    power_save         = POWER_SAVE_HIGH;
 
+int             num_passes         = 0;                 // Run until stopped (default)
+exit_action_t   exit_action        = EXIT_HALT;
+int             time_budget        = 0;                 // in minutes, 0 = no budget (default)
+
 bool            enable_tty         = false;
+bool            enable_tty_json    = false;             // Send line-delimited JSON records instead of the screen
 uintptr_t       tty_address        = 0x3F8;             // Legacy IO or MMIO Address accepted
 int             tty_baud_rate      = 115200;
 int             tty_update_period  = 2;                 // Update TTY every 2 seconds (default)
@@ -117,6 +142,209 @@ bool            err_banner_redraw  = false;             // Redraw banner on new
 // Private Functions
 //------------------------------------------------------------------------------
 
+// Parses a decimal or (with a 0x prefix) hexadecimal number. Returns a pointer
+// to the first character following the number, or NULL if there is no number.
+static const char *parse_number(const char *str, uint64_t *value)
+{
+    int base = 10;
+    if (str[0] == '0' && (str[1] == 'x' || str[1] == 'X')) {
+        base = 16;
+        str += 2;
+    }
+    const char *start = str;
+    *value = 0;
+    while (*str != '\0') {
+        int digit;
+        if (*str >= '0' && *str <= '9') {
+            digit = *str - '0';
+        } else if (base == 16 && *str >= 'a' && *str <= 'f') {
+            digit = *str - 'a' + 10;
+        } else if (base == 16 && *str >= 'A' && *str <= 'F') {
+            digit = *str - 'A' + 10;
+        } else {
+            break;
+        }
+        *value = *value * base + digit;
+        str++;
+    }
+    return str > start ? str : NULL;
+}
+
+// Parses a number followed by an optional K, M, G, or T suffix.
+static const char *parse_size(const char *str, uint64_t *value)
+{
+    str = parse_number(str, value);
+    if (str == NULL) {
+        return NULL;
+    }
+    switch (*str) {
+      case 'k': case 'K': *value <<= 10; str++; break;
+      case 'm': case 'M': *value <<= 20; str++; break;
+      case 'g': case 'G': *value <<= 30; str++; break;
+      case 't': case 'T': *value <<= 40; str++; break;
+      default:
+        break;
+    }
+    return str;
+}
+
+// Parses "<n>[-<m>][,<n>[-<m>]...]", setting the selected flag of each number
+// listed. Returns false, leaving the flags unchanged, if the list is invalid
+// or contains a number not less than size.
+static bool parse_number_list(const char *params, bool selected[], int size)
+{
+    bool listed[MAX_CPUS];
+
+    if (params == NULL || size > MAX_CPUS) {
+        return false;
+    }
+    for (int i = 0; i < size; i++) {
+        listed[i] = false;
+    }
+    while (true) {
+        uint64_t first, last;
+        params = parse_number(params, &first);
+        if (params == NULL) {
+            return false;
+        }
+        last = first;
+        if (*params == '-') {
+            params = parse_number(params + 1, &last);
+            if (params == NULL) {
+                return false;
+            }
+        }
+        if (first > last || last >= (uint64_t)size) {
+            return false;
+        }
+        for (uint64_t i = first; i <= last; i++) {
+            listed[i] = true;
+        }
+        if (*params == '\0') {
+            break;
+        }
+        if (*params++ != ',') {
+            return false;
+        }
+    }
+    for (int i = 0; i < size; i++) {
+        selected[i] = listed[i];
+    }
+    return true;
+}
+
+static void parse_tests_params(const char *params)
+{
+    bool selected[NUM_TEST_PATTERNS];
+
+    if (parse_number_list(params, selected, NUM_TEST_PATTERNS)) {
+        for (int i = 0; i < NUM_TEST_PATTERNS; i++) {
+            test_list[i].enabled = selected[i];
+        }
+    }
+}
+
+static void parse_cpus_params(const char *params)
+{
+    bool selected[MAX_CPUS];
+
+    if (parse_number_list(params, selected, MAX_CPUS)) {
+        // The boot CPU is always used.
+        for (int i = 1; i < MAX_CPUS; i++) {
+            cpu_state[i] = selected[i] ? CPU_STATE_ENABLED : CPU_STATE_DISABLED;
+        }
+    }
+}
+
+// Parses "<start>-<end>", where start and end are physical byte addresses,
+// with an optional size suffix. The end address is exclusive.
+static void parse_memrange_params(const char *params)
+{
+    uint64_t start, end;
+
+    if (params == NULL) {
+        return;
+    }
+    params = parse_size(params, &start);
+    if (params == NULL || *params++ != '-') {
+        return;
+    }
+    params = parse_size(params, &end);
+    if (params == NULL || *params != '\0' || end <= start) {
+        return;
+    }
+
+    uint64_t lower = start >> PAGE_SHIFT;
+    uint64_t upper = (end + PAGE_SIZE - 1) >> PAGE_SHIFT;
+    if (lower >= pm_limit_upper) {
+        return;
+    }
+    pm_limit_lower = lower;
+    if (upper < pm_limit_upper) {
+        pm_limit_upper = upper;
+    }
+}
+
+// Parses "<test>,<pass>,<start>[-<end>]", where start and end are physical
+// byte addresses. If end is omitted, the page containing start is replayed.
+static void parse_replay_params(const char *params)
+{
+    uint64_t test, pass, start, end;
+
+    if (params == NULL) {
+        return;
+    }
+    params = parse_number(params, &test);
+    if (params == NULL || *params++ != ',' || test >= NUM_TEST_PATTERNS) {
+        return;
+    }
+    params = parse_number(params, &pass);
+    if (params == NULL || *params++ != ',') {
+        return;
+    }
+    params = parse_number(params, &start);
+    if (params == NULL) {
+        return;
+    }
+    end = start + 1;
+    if (*params == '-') {
+        params = parse_number(params + 1, &end);
+        if (params == NULL || end <= start) {
+            return;
+        }
+    }
+
+    replay_test  = test;
+    replay_pass  = pass;
+    replay_start = start >> PAGE_SHIFT;
+    replay_end   = (end + PAGE_SIZE - 1) >> PAGE_SHIFT;
+}
+
+// Parses "<addr>[:<mask>][,<addr>[:<mask>]...]". If a mask is not specified,
+// bit 0 of the word containing the address is flipped.
+static void parse_inject_params(const char *params)
+{
+    while (params != NULL && num_inject_addrs < MAX_INJECT_ADDRS) {
+        uint64_t addr, mask = 1;
+        params = parse_number(params, &addr);
+        if (params == NULL) {
+            return;
+        }
+        if (*params == ':') {
+            params = parse_number(params + 1, &mask);
+            if (params == NULL) {
+                return;
+            }
+        }
+        inject_addr[num_inject_addrs] = addr;
+        inject_mask[num_inject_addrs] = mask;
+        num_inject_addrs++;
+        if (*params++ != ',') {
+            return;
+        }
+    }
+}
+
 static void parse_serial_params(const char *params)
 {
     enable_tty = true;
@@ -126,6 +354,26 @@ static void parse_serial_params(const char *params)
         return;
     }
 
+    // Check for a trailing "json" (structured output) and strip it
+    char port_params[32];
+    size_t len = strlen(params);
+    if (len >= 4 && strncmp(params + len - 4, "json", 5) == 0) {
+        enable_tty_json = true;
+        len -= 4;
+        if (len > 0 && params[len - 1] == ',') {
+            len--;
+        }
+        if (len >= sizeof(port_params)) {
+            len = sizeof(port_params) - 1;
+        }
+        memcpy(port_params, params, len);
+        port_params[len] = '\0';
+        params = port_params;
+        if (len == 0) {
+            return;
+        }
+    }
+
     // Check if console is MMIO and grab address and stride
     uintptr_t mmio_adr = 0;
     if (strncmp(params, "mmio,0x", 7) == 0) {
@@ -203,6 +451,16 @@ static void parse_option(const char *option, const char *params)
 
     if (strncmp(option, "console", 8) == 0) {
         parse_serial_params(params);
+    } else if (strncmp(option, "bench", 6) == 0) {
+        enable_bench = true;
+        show_bench_results = true;
+    } else if (strncmp(option, "budget", 7) == 0 && params != NULL) {
+        uint64_t minutes;
+        if (parse_number(params, &minutes) != NULL && minutes <= INT32_MAX / 60) {
+            time_budget = minutes;
+        }
+    } else if (strncmp(option, "cpus", 5) == 0) {
+        parse_cpus_params(params);
     } else if (strncmp(option, "cpuseqmode", 11) == 0) {
         if (strncmp(params, "par", 4) == 0) {
             cpu_mode = PAR;
@@ -211,6 +469,8 @@ static void parse_option(const char *option, const char *params)
         } else if (strncmp(params, "rr", 3) == 0 || strncmp(params, "one", 4) == 0) {
             cpu_mode = ONE;
         }
+    } else if (strncmp(option, "quickpass", 10) == 0) {
+        enable_quick_pass = true;
     } else if (strncmp(option, "reportmode", 11) == 0) {
         if (strncmp(params, "none", 5) == 0) {
             error_mode = ERROR_MODE_NONE;
@@ -221,6 +481,15 @@ static void parse_option(const char *option, const char *params)
         } else if (strncmp(params, "badram", 7) == 0) {
             error_mode = ERROR_MODE_BADRAM;
         }
+    } else if (strncmp(option, "focus", 6) == 0) {
+        enable_focus = true;
+    } else if (strncmp(option, "inject", 7) == 0) {
+        parse_inject_params(params);
+    } else if (strncmp(option, "injectrate", 11) == 0 && params != NULL) {
+        uint64_t rate;
+        if (parse_number(params, &rate) != NULL) {
+            inject_rate = rate;
+        }
     } else if (strncmp(option, "keyboard", 9) == 0 && params != NULL) {
         if (strncmp(params, "legacy", 7) == 0) {
             keyboard_types = KT_LEGACY;
@@ -229,6 +498,8 @@ static void parse_option(const char *option, const char *params)
         } else if (strncmp(params, "both", 5) == 0) {
             keyboard_types = KT_USB|KT_LEGACY;
         }
+    } else if (strncmp(option, "memrange", 9) == 0) {
+        parse_memrange_params(params);
     } else if (strncmp(option, "nobench", 8) == 0) {
         enable_bench = false;
     } else if (strncmp(option, "nobigstatus", 12) == 0) {
@@ -243,6 +514,19 @@ static void parse_option(const char *option, const char *params)
         enable_sm = false;
     } else if (strncmp(option, "nosmp", 6) == 0) {
         smp_enabled = false;
+    } else if (strncmp(option, "onexit", 7) == 0 && params != NULL) {
+        if (strncmp(params, "halt", 5) == 0) {
+            exit_action = EXIT_HALT;
+        } else if (strncmp(params, "reboot", 7) == 0) {
+            exit_action = EXIT_REBOOT;
+        } else if (strncmp(params, "poweroff", 9) == 0) {
+            exit_action = EXIT_POWEROFF;
+        }
+    } else if (strncmp(option, "passes", 7) == 0 && params != NULL) {
+        uint64_t passes;
+        if (parse_number(params, &passes) != NULL && passes <= INT32_MAX) {
+            num_passes = passes;
+        }
     } else if (strncmp(option, "powersave", 10) == 0) {
         if (strncmp(params, "off", 4) == 0) {
             power_save = POWER_SAVE_OFF;
@@ -251,6 +535,14 @@ static void parse_option(const char *option, const char *params)
         } else if (strncmp(params, "high", 5) == 0) {
             power_save = POWER_SAVE_HIGH;
         }
+    } else if (strncmp(option, "profile", 8) == 0) {
+        enable_profile = true;
+    } else if (strncmp(option, "replay", 7) == 0) {
+        parse_replay_params(params);
+    } else if (strncmp(option, "seed", 5) == 0 && params != NULL) {
+        enable_fixed_seed = parse_number(params, &fixed_seed) != NULL;
+    } else if (strncmp(option, "tests", 6) == 0) {
+        parse_tests_params(params);
     } else if (strncmp(option, "trace", 6) == 0) {
         enable_trace = true;
     } else if (strncmp(option, "usbdebug", 9) == 0) {
@@ -830,8 +1122,6 @@ void config_init(void)
     pm_limit_lower = 0;
     pm_limit_upper = pm_map[pm_map_size - 1].end;
 
-    update_num_pages_to_test();
-
     cpu_mode = PAR;
 
     error_mode = ERROR_MODE_ADDRESS;
@@ -853,6 +1143,13 @@ void config_init(void)
             parse_command_line((char *)cmd_line_addr, cmd_line_size);
         }
     }
+
+    // A time budget is for the whole run.
+    if (time_budget > 0 && num_passes == 0) {
+        num_passes = 1;
+    }
+
+    update_num_pages_to_test();
 }
 
 void config_menu(bool initial)
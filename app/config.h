@@ -16,6 +16,8 @@
 #include "smp.h"
 #include "cpuid.h"
 
+#define MAX_INJECT_ADDRS    8
+
 typedef enum {
     PAR,
     SEQ,
@@ -29,6 +31,12 @@ typedef enum {
     ERROR_MODE_BADRAM
 } error_mode_t;
 
+typedef enum {
+    EXIT_HALT,
+    EXIT_REBOOT,
+    EXIT_POWEROFF
+} exit_action_t;
+
 typedef enum {
     POWER_SAVE_OFF,
     POWER_SAVE_LOW,
@@ -57,13 +65,38 @@ extern bool         enable_trace;
 
 extern bool         enable_sm;
 extern bool         enable_tty;
+extern bool         enable_tty_json;
 extern bool         enable_bench;
+extern bool         show_bench_results;
 extern bool         enable_mch_read;
 
+extern bool         enable_focus;
+
+extern bool         enable_quick_pass;
+
+extern bool         enable_profile;
+
+extern bool         enable_fixed_seed;
+extern uint64_t     fixed_seed;
+
+extern int          num_inject_addrs;
+extern uint64_t     inject_addr[];
+extern uint64_t     inject_mask[];
+extern uint32_t     inject_rate;
+
+extern int          replay_test;
+extern int          replay_pass;
+extern uintptr_t    replay_start;
+extern uintptr_t    replay_end;
+
 extern bool         pause_at_start;
 
 extern power_save_t power_save;
 
+extern int          num_passes;
+extern int          time_budget;
+extern exit_action_t exit_action;
+
 extern uintptr_t    tty_address;
 extern int          tty_baud_rate;
 extern int          tty_update_period;
@@ -10,6 +10,7 @@
 #include "hwctrl.h"
 #include "io.h"
 #include "keyboard.h"
+#include "mca.h"
 #include "memctrl.h"
 #include "serial.h"
 #include "pmem.h"
@@ -23,6 +24,7 @@
 
 #include "config.h"
 #include "error.h"
+#include "profile.h"
 #include "build_version.h"
 
 #include "tests.h"
@@ -73,6 +75,11 @@ static uint64_t next_spin_time = 0; // TSC time stamp
 static int prev_sec = -1;               // previous second
 static bool timed_update_done = false;  // update cycle status
 
+static uint64_t prev_traffic_time = 0;  // TSC time stamp
+static uint32_t prev_traffic_lines[IMC_MAX_CHANNELS];  // DRAM traffic counter values
+
+static bool dimm_temp_displayed = false; // DIMM temperature field shown
+
 bool big_status_displayed = false;
 static uint16_t popup_status_save_buffer[POP_STAT_W * POP_STAT_H];
 
@@ -340,8 +347,21 @@ void display_temperature(void)
 
     int actual_cpu_temp = get_cpu_temperature();
 
+    // This is only called once per second, which also rate-limits the SMBus reads.
+    int dimm_temp = poll_dimm_temperature();
+
+    // The hottest DIMM has its own labelled field, set into the line below
+    // the memory details.
+    if (dimm_temp > 0) {
+        display_dimm_temperature(dimm_temp);
+        dimm_temp_displayed = true;
+    } else if (dimm_temp_displayed) {
+        clear_dimm_temperature();
+        dimm_temp_displayed = false;
+    }
+
     if (actual_cpu_temp == 0) {
-        if (max_cpu_temp == 0) {
+        if (max_cpu_temp == 0 && !dimm_temp_displayed) {
             enable_temperature = false;
         }
         return;
@@ -357,6 +377,43 @@ void display_temperature(void)
     printf(1, 20-offset, "%2i/%2i%cC", actual_cpu_temp, max_cpu_temp, 0xF8);
 }
 
+void display_dram_traffic(void)
+{
+    uint32_t lines[IMC_MAX_CHANNELS];
+
+    int num_counters = clks_per_msec ? memctrl_read_traffic(lines) : 0;
+    if (num_counters == 0) {
+        return;
+    }
+
+    uint64_t current_time = get_tsc();
+    uint64_t elapsed_ms = (current_time - prev_traffic_time) / clks_per_msec;
+    if (prev_traffic_time != 0 && elapsed_ms > 0) {
+        // The counters are free-running, so take the differences modulo 2^32.
+        // 64 bytes per line, shown in decimal GB/s (bytes/ms / 10^6) to one
+        // decimal place.
+        uint32_t tenths[IMC_MAX_CHANNELS];
+        uint32_t total_tenths = 0;
+        for (int i = 0; i < num_counters; i++) {
+            uint64_t lines_moved = (uint32_t)(lines[i] - prev_traffic_lines[i]);
+            tenths[i] = ((lines_moved * 64) / elapsed_ms) / 100000;
+            total_tenths += tenths[i];
+        }
+        clear_dram_traffic();
+        int col = printf(6, 44, " Live DRAM %u.%uGB/s ",
+                         (uintptr_t)(total_tenths / 10), (uintptr_t)(total_tenths % 10));
+        if (num_counters > 1) {
+            for (int i = 0; i < num_counters; i++) {
+                col = printf(6, col, "%c %u.%u ", 'A' + i, (uintptr_t)(tenths[i] / 10), (uintptr_t)(tenths[i] % 10));
+            }
+        }
+    }
+    prev_traffic_time = current_time;
+    for (int i = 0; i < num_counters; i++) {
+        prev_traffic_lines[i] = lines[i];
+    }
+}
+
 void display_big_status(bool pass)
 {
     if (!enable_big_status || big_status_displayed) {
@@ -471,27 +528,51 @@ void scroll(void)
 void do_tick(int my_cpu)
 {
     int act_sec = 0;
+
+    uint64_t start_time = profile_start();
+
+    // The memory controller MCA banks are shared by a package, so only one CPU
+    // in each package reads them.
+    mca_error_t mca_errors[MCA_MAX_ERRORS];
+    int num_mca_errors = mca_poll(my_cpu, mca_errors);
+    for (int i = 0; i < num_mca_errors; i++) {
+        ecc_error(mca_errors[i].addr_valid, mca_errors[i].addr, mca_errors[i].uncorrected, mca_errors[i].syndrome);
+    }
+
+    // Throttling is detected per-CPU (or per-core).
+    profile_tick(my_cpu);
+
+    profile_end(my_cpu, PROFILE_TICK, start_time);
+
     bool use_spin_wait = (power_save < POWER_SAVE_HIGH);
+    start_time = profile_start();
     if (use_spin_wait) {
         barrier_spin_wait(run_barrier);
     } else {
         barrier_halt_wait(run_barrier);
     }
+    profile_end(my_cpu, PROFILE_RUN_BARRIER, start_time);
     if (master_cpu == my_cpu) {
+        start_time = profile_start();
         check_input();
         error_update();
+        profile_end(my_cpu, PROFILE_TICK, start_time);
     }
+    start_time = profile_start();
     if (use_spin_wait) {
         barrier_spin_wait(run_barrier);
     } else {
         barrier_halt_wait(run_barrier);
     }
+    profile_end(my_cpu, PROFILE_RUN_BARRIER, start_time);
 
     // Only the master CPU does the update.
     if (master_cpu != my_cpu) {
         return;
     }
 
+    start_time = profile_start();
+
     test_ticks++;
     pass_ticks++;
 
@@ -554,6 +635,9 @@ void do_tick(int my_cpu)
         // Update temperature
         display_temperature();
 
+        // Update the live DRAM throughput
+        display_dram_traffic();
+
         // Update TTY one time every TTY_UPDATE_PERIOD second(s)
         if (enable_tty) {
 
@@ -568,6 +652,8 @@ void do_tick(int my_cpu)
         prev_sec = act_sec;
         timed_update_done = false;
     }
+
+    profile_end(my_cpu, PROFILE_TICK, start_time);
 }
 
 void do_trace(int my_cpu, const char *fmt, ...)
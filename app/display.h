@@ -72,6 +72,23 @@ typedef enum {
 #define display_ram_speed(speed) \
     printf(5, 18, "%S6kB/s", (uintptr_t)(speed))
 
+#define display_dimm_temperature(temp) \
+    printf(6, 1, " DIMM Temp %2i%cC ", temp, 0xF8)
+
+#define clear_dram_traffic() \
+    { \
+        for (int i = 43; i < SCREEN_WIDTH; i++) { \
+            print_char(6, i, 0xc4); \
+        } \
+    }
+
+#define clear_dimm_temperature() \
+    { \
+        for (int i = 1; i < 18; i++) { \
+            print_char(6, i, 0xc4); \
+        } \
+    }
+
 #define display_status(status) \
     prints(7, 68, status)
 
@@ -247,6 +264,15 @@ void display_start_test(void);
 
 void display_temperature(void);
 
+/**
+ * Shows the DRAM throughput (reads plus writes) measured by the memory
+ * controller since the last call, in its own labelled field in the line
+ * below the test details, if the memory controller provides traffic
+ * counters. The throughput of each channel is also shown where the
+ * controller counts the channels separately.
+ */
+void display_dram_traffic(void);
+
 void display_big_status(bool pass);
 
 void restore_big_status(void);
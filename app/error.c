@@ -13,6 +13,9 @@
 
 #include <limits.h>
 
+#include "memctrl.h"
+#include "smbios.h"
+#include "smbus.h"
 #include "smp.h"
 #include "vmem.h"
 
@@ -26,6 +29,7 @@
 #include "serial.h"
 
 #include "error.h"
+#include "json.h"
 
 //------------------------------------------------------------------------------
 // Constants
@@ -35,11 +39,21 @@
 #define USB_WORKAROUND 1
 #endif
 
+#define FOCUS_GUARD_PAGES   256     // 1MB either side of a failing page
+
+#define NUM_BYTE_LANES      (TESTWORD_WIDTH / 8)
+
+#define UNKNOWN_PAGE        UINTPTR_MAX
+
 //------------------------------------------------------------------------------
 // Types
 //------------------------------------------------------------------------------
 
-typedef enum { ADDR_ERROR, DATA_ERROR, PARITY_ERROR, NEW_MODE } error_type_t;
+typedef enum { ADDR_ERROR, DATA_ERROR, PARITY_ERROR, ECC_CORRECTED, ECC_UNCORRECTED, NEW_MODE } error_type_t;
+
+static const char *error_type_name[] = {
+    "address", "data", "parity", "ecc_corrected", "ecc_uncorrected", "new_mode"
+};
 
 typedef struct {
     uintptr_t           page;
@@ -57,6 +71,22 @@ typedef struct {
     uintptr_t           max_run;
     uintptr_t           last_addr;
     testword_t          last_xor;
+    uint64_t            data_errors;
+    uint64_t            bit_errors[TESTWORD_WIDTH];
+    uint64_t            lane_errors[NUM_BYTE_LANES];
+    uint64_t            dimm_errors[IMC_MAX_CHANNELS][IMC_MAX_DIMMS_PER_CHANNEL];
+    uint64_t            decoded_errors;
+    uint64_t            slot_errors[MAX_DIMM_SLOTS];
+    uint64_t            located_errors;
+    uint64_t            ecc_corrected;
+    uint64_t            ecc_uncorrected;
+    testword_t          seed;
+    int                 seed_test;
+    int                 seed_pass;
+    int                 last_slot;
+    int                 dimm_temp;
+    int                 min_dimm_temp;
+    int                 max_dimm_temp;
 } error_info_t;
 
 //------------------------------------------------------------------------------
@@ -67,16 +97,55 @@ static error_mode_t     last_error_mode = ERROR_MODE_NONE;
 
 static error_info_t     error_info;
 
+static bool             new_histograms = false;
+
 //------------------------------------------------------------------------------
 // Public Variables
 //------------------------------------------------------------------------------
 
 uint64_t                error_count = 0;
 
+focus_range_t           focus_map[MAX_FOCUS_RANGES];
+int                     focus_map_size = 0;
+
 //------------------------------------------------------------------------------
 // Private Functions
 //------------------------------------------------------------------------------
 
+static int attribute_error(testword_t page, testword_t offset, bool counted)
+{
+    if (page == UNKNOWN_PAGE) {
+        return -1;
+    }
+    uint64_t phys_addr = ((uint64_t)page << PAGE_SHIFT) | offset;
+
+    // Annotate the error with the DIMM slot named by the SMBIOS tables.
+
+    int slot = smbios_dimm_slot(phys_addr);
+    if (error_count >= ERROR_LIMIT) {
+        return slot;
+    }
+    if (slot >= 0) {
+        error_info.slot_errors[slot]++;
+        error_info.located_errors++;
+        new_histograms = true;
+    }
+
+    // Attribute the error to a DIMM slot if the memory controller allows it.
+
+    dram_addr_t dram_addr;
+    if (memctrl_decode_addr(phys_addr, &dram_addr)) {
+        error_info.dimm_errors[dram_addr.channel][dram_addr.dimm]++;
+        // Only errors included in the error count are compared with it.
+        if (counted) {
+            error_info.decoded_errors++;
+        }
+        new_histograms = true;
+    }
+
+    return slot;
+}
+
 static bool update_error_info(testword_t page, testword_t offset, uintptr_t addr, testword_t xor)
 {
     bool update_stats = false;
@@ -100,16 +169,26 @@ static bool update_error_info(testword_t page, testword_t offset, uintptr_t addr
         update_stats = true;
     }
 
-    // Update bits in error.
+    // Update bits in error and the per-bit and per-byte-lane histograms.
+    // Only the set bits of the XOR are visited, lowest first.
 
     int bits = 0;
-    for (int i = 0; i < TESTWORD_WIDTH; i++) {
-        if ((xor >> i) & 1) {
-            bits++;
+    unsigned lanes = 0;
+    for (testword_t mask = xor; mask != 0; mask &= mask - 1) {
+        int bit = __builtin_ctzl(mask);
+        if (error_count < ERROR_LIMIT) {
+            error_info.bit_errors[bit]++;
         }
+        lanes |= 1 << (bit / 8);
+        bits++;
     }
     if (bits > 0 && error_count < ERROR_LIMIT) {
         error_info.total_bits += bits;
+        error_info.data_errors++;
+        for (; lanes != 0; lanes &= lanes - 1) {
+            error_info.lane_errors[__builtin_ctz(lanes)]++;
+        }
+        new_histograms = true;
     }
     if (bits > error_info.max_bits) {
         error_info.max_bits = bits;
@@ -144,13 +223,164 @@ static bool update_error_info(testword_t page, testword_t offset, uintptr_t addr
     return update_stats;
 }
 
-static void common_err(error_type_t type, uintptr_t addr, testword_t good, testword_t bad, bool use_for_badram)
+static void display_dimm_errors(void)
+{
+    bool any_decoded = false;
+    for (int ch = 0; ch < IMC_MAX_CHANNELS; ch++) {
+        for (int dimm = 0; dimm < IMC_MAX_DIMMS_PER_CHANNEL; dimm++) {
+            any_decoded |= error_info.dimm_errors[ch][dimm] > 0;
+        }
+    }
+    if (!any_decoded) {
+        return;
+    }
+
+    display_pinned_message(8, 1, "   Errors by Chan/DIMM:");
+    int col = 25;
+    for (int ch = 0; ch < IMC_MAX_CHANNELS; ch++) {
+        for (int dimm = 0; dimm < IMC_MAX_DIMMS_PER_CHANNEL; dimm++) {
+            if (error_info.dimm_errors[ch][dimm] > 0 && col < 56) {
+                col = display_pinned_message(8, col, "%c%i:%u ", 'A' + ch, dimm + 1,
+                                             (uintptr_t)error_info.dimm_errors[ch][dimm]);
+            }
+        }
+    }
+    // Corrected ECC errors are included in the per-DIMM counts but not in
+    // the error count, so they are excluded from decoded_errors.
+    uint64_t undecoded = error_count > error_info.decoded_errors ? error_count - error_info.decoded_errors : 0;
+    if (undecoded > 0 && col < 56) {
+        display_pinned_message(8, col, "?:%u", (uintptr_t)undecoded);
+    }
+}
+
+static void display_slot_errors(void)
+{
+    if (error_info.located_errors == 0) {
+        return;
+    }
+
+    display_pinned_message(9, 1, "   Errors by DIMM Slot:");
+    int col = 25;
+    for (int slot = 0; slot < MAX_DIMM_SLOTS; slot++) {
+        if (error_info.slot_errors[slot] > 0) {
+            const char *name = smbios_dimm_slot_name(slot);
+            if (col + (int)strlen(name) + 4 > 63) {
+                break;
+            }
+            col = display_pinned_message(9, col, "%s:%u ", name, (uintptr_t)error_info.slot_errors[slot]);
+        }
+    }
+}
+
+static void display_ecc_errors(void)
+{
+    if (error_info.ecc_corrected == 0 && error_info.ecc_uncorrected == 0) {
+        return;
+    }
+
+    display_pinned_message(10, 1, "  ECC Errors (CE / UE):");
+    display_pinned_message(10, 25, "%u / %u", (uintptr_t)error_info.ecc_corrected,
+                                              (uintptr_t)error_info.ecc_uncorrected);
+}
+
+static void display_histograms(void)
+{
+    display_dimm_errors();
+    display_slot_errors();
+    display_ecc_errors();
+
+    if (error_info.data_errors == 0) {
+        return;
+    }
+
+    // Byte lanes are shown as the percentage of data errors that touched the lane.
+    for (int lane = NUM_BYTE_LANES - 1, col = 25; lane >= 0; lane--, col += 4) {
+        display_pinned_message(5, col, "%3i", (int)((100 * error_info.lane_errors[lane]) / error_info.data_errors));
+    }
+
+    // Data bits are shown as a single digit giving the share of data errors
+    // (in tenths, rounded up) that involved the bit, or '.' if it never failed.
+    char line[32 + 4];
+    for (int bit = TESTWORD_WIDTH - 1; bit >= 0; bit--) {
+        int pos = 31 - (bit % 32);
+        char ch = '.';
+        if (error_info.bit_errors[bit] > 0) {
+            int tenths = (10 * error_info.bit_errors[bit] + error_info.data_errors - 1) / error_info.data_errors;
+            ch = '0' + (tenths > 9 ? 9 : tenths);
+        }
+        line[pos + pos / 8] = ch;
+        if (pos % 8 == 7 && pos < 31) {
+            line[pos + pos / 8 + 1] = ' ';
+        }
+        if (bit % 32 == 0) {
+            line[sizeof(line) - 1] = '\0';
+            display_pinned_message(6 + (TESTWORD_WIDTH - 1 - bit) / 32, 25, "%s", line);
+        }
+    }
+}
+
+static void update_focus_map(uintptr_t page)
+{
+    uintptr_t start = (page > FOCUS_GUARD_PAGES) ? page - FOCUS_GUARD_PAGES : 0;
+    uintptr_t end   = page + FOCUS_GUARD_PAGES + 1;
+
+    // In focus mode the map being tested may change, so count it again.
+    if (focus_mode) {
+        windows_scanned = false;
+    }
+
+    int i = 0;
+    while (i < focus_map_size && focus_map[i].end < start) {
+        i++;
+    }
+
+    if (i < focus_map_size && focus_map[i].start <= end) {
+        // Extend the overlapping range and absorb any ranges it now reaches.
+        if (focus_map[i].start > start) {
+            focus_map[i].start = start;
+        }
+        if (focus_map[i].end < end) {
+            focus_map[i].end = end;
+        }
+        while (i + 1 < focus_map_size && focus_map[i + 1].start <= focus_map[i].end) {
+            if (focus_map[i].end < focus_map[i + 1].end) {
+                focus_map[i].end = focus_map[i + 1].end;
+            }
+            for (int j = i + 1; j < focus_map_size - 1; j++) {
+                focus_map[j] = focus_map[j + 1];
+            }
+            focus_map_size--;
+        }
+        return;
+    }
+
+    if (focus_map_size == MAX_FOCUS_RANGES) {
+        // No room for a new range, so widen the nearest one.
+        if (i == focus_map_size || (i > 0 && start - focus_map[i - 1].end < focus_map[i].start - end)) {
+            focus_map[i - 1].end = end;
+        } else {
+            focus_map[i].start = start;
+        }
+        return;
+    }
+
+    for (int j = focus_map_size; j > i; j--) {
+        focus_map[j] = focus_map[j - 1];
+    }
+    focus_map[i].start = start;
+    focus_map[i].end   = end;
+    focus_map_size++;
+}
+
+static void record_err(error_type_t type, testword_t page, testword_t offset, uintptr_t addr,
+                       testword_t good, testword_t bad, bool use_for_badram)
 {
     spin_lock(error_mutex);
 
     restore_big_status();
 
-    bool new_header = (error_count == 0) || (error_mode != last_error_mode);
+    bool first_report = (error_count == 0 && error_info.ecc_corrected == 0);
+    bool new_header = first_report || (error_mode != last_error_mode);
     if (new_header) {
         clear_message_area();
         badram_init();
@@ -160,15 +390,27 @@ static void common_err(error_type_t type, uintptr_t addr, testword_t good, testw
     testword_t xor = good ^ bad;
 
     bool new_stats = false;
-    testword_t page   = page_of((void *)addr);
-    testword_t offset = addr & (PAGE_SIZE - 1);
+
+    int slot = -1;
 
     switch (type) {
       case ADDR_ERROR:
         new_stats = update_error_info(page, offset, addr, 0);
+        slot = attribute_error(page, offset, true);
         break;
       case DATA_ERROR:
         new_stats = update_error_info(page, offset, addr, xor);
+        slot = attribute_error(page, offset, true);
+        break;
+      case ECC_CORRECTED:
+        error_info.ecc_corrected++;
+        slot = attribute_error(page, offset, false);
+        new_histograms = true;
+        break;
+      case ECC_UNCORRECTED:
+        error_info.ecc_uncorrected++;
+        slot = attribute_error(page, offset, true);
+        new_histograms = true;
         break;
       case NEW_MODE:
         new_stats = (error_count > 0);
@@ -178,12 +420,57 @@ static void common_err(error_type_t type, uintptr_t addr, testword_t good, testw
 
     bool new_address = (type != NEW_MODE);
 
+    const char *slot_name = slot >= 0 ? smbios_dimm_slot_name(slot) : NULL;
+
+    if (new_address) {
+        json_error(error_type_name[type], page != UNKNOWN_PAGE, ((uint64_t)page << PAGE_SHIFT) + offset, slot_name,
+                   good, bad);
+    }
+
+    // Name the DIMM slot of each error whose slot differs from the last one shown.
+    bool new_slot = new_address && slot >= 0 && slot != error_info.last_slot;
+    if (new_address) {
+        error_info.last_slot = slot;
+    }
+
+    // Record the seed used by this CPU in the test invocation, so the failure
+    // can be replayed.
+    bool new_seed = false;
+    testword_t seed = cpu_seed(smp_my_cpu_num());
+    if (type == ADDR_ERROR || type == DATA_ERROR) {
+        new_seed = error_info.seed != seed || error_info.seed_test != test_num
+                || error_info.seed_pass != pass_num;
+        error_info.seed      = seed;
+        error_info.seed_test = test_num;
+        error_info.seed_pass = pass_num;
+    }
+
+    // Record the DIMM temperature at the time of the failure, as retention
+    // failures depend on it.
+    bool new_temp = false;
+    int dimm_temp = get_dimm_temperature();
+    if (new_address && dimm_temp > 0) {
+        new_temp = dimm_temp != error_info.dimm_temp;
+        error_info.dimm_temp = dimm_temp;
+        if (error_info.min_dimm_temp == 0 || dimm_temp < error_info.min_dimm_temp) {
+            error_info.min_dimm_temp = dimm_temp;
+        }
+        if (dimm_temp > error_info.max_dimm_temp) {
+            error_info.max_dimm_temp = dimm_temp;
+        }
+    }
+
+    if (page != UNKNOWN_PAGE && type != PARITY_ERROR && type != NEW_MODE) {
+        update_focus_map(page);
+    }
+
     bool new_badram = false;
     if (error_mode == ERROR_MODE_BADRAM && use_for_badram) {
         new_badram = badram_insert(page, offset);
     }
 
-    if (new_address) {
+    // Corrected ECC errors are reported, but do not fail the test.
+    if (new_address && type != ECC_CORRECTED) {
         if (error_count < ERROR_LIMIT) {
             error_count++;
         }
@@ -203,6 +490,18 @@ static void common_err(error_type_t type, uintptr_t addr, testword_t good, testw
             display_pinned_message(2, 1,  "    Bits in Error Mask:");
             display_pinned_message(3, 1,  " Bits in Error - Total:");
             display_pinned_message(4, 1,  " Max Contiguous Errors:");
+            display_pinned_message(5, 1,  "  Byte Lane Errors (%):");
+#if TESTWORD_WIDTH > 32
+            display_pinned_message(6, 1,  "     Bit Errors 63..32:");
+            display_pinned_message(7, 1,  "      Bit Errors 31..0:");
+#else
+            display_pinned_message(6, 1,  "      Bit Errors 31..0:");
+#endif
+            display_pinned_message(11, 1, "  Seed of Last Failure:");
+            if (dimm_temp > 0) {
+                display_pinned_message(12, 1, "  DIMM Temp at Failure:");
+            }
+            new_histograms = true;
 
             display_pinned_message(0, 64, "Test  Errors");
             for (int i = 0; i < NUM_TEST_PATTERNS; i++) {
@@ -234,6 +533,10 @@ static void common_err(error_type_t type, uintptr_t addr, testword_t good, testw
                                           (int)(error_info.total_bits / error_count));
             display_pinned_message(4, 25, "%u",
                                           error_info.max_run);
+            display_pinned_message(11, 25, "%0*x (test %i pass %i)", TESTWORD_DIGITS,
+                                          error_info.seed,
+                                          error_info.seed_test,
+                                          error_info.seed_pass);
 
             for (int i = 0; i < NUM_TEST_PATTERNS; i++) {
                 display_pinned_message(1 + i, 69, "%c%i",
@@ -243,11 +546,18 @@ static void common_err(error_type_t type, uintptr_t addr, testword_t good, testw
 
             display_error_count(error_count);
         }
+        if (new_temp || (new_header && error_info.dimm_temp > 0)) {
+            display_pinned_message(12, 25, "%i%cC (min %i%cC, max %i%cC)  ",
+                                          error_info.dimm_temp, 0xF8,
+                                          error_info.min_dimm_temp, 0xF8,
+                                          error_info.max_dimm_temp, 0xF8);
+        }
         break;
 
       case ERROR_MODE_ADDRESS:
         // Skip duplicates.
-        if (!new_header && addr == error_info.last_addr && xor == error_info.last_xor) {
+        if (!new_header && (type == ADDR_ERROR || type == DATA_ERROR)
+        &&  addr == error_info.last_addr && xor == error_info.last_xor) {
             break;
         }
         if (new_header) {
@@ -267,11 +577,31 @@ static void common_err(error_type_t type, uintptr_t addr, testword_t good, testw
             check_input();
             scroll();
 
+            if (new_seed) {
+                display_scrolled_message(0, "  -   %4i   %2i   seed=%x", pass_num, test_num, seed);
+                scroll();
+            }
+            if (new_temp) {
+                display_scrolled_message(0, "  -   %4i   %2i   DIMM temperature %i%cC", pass_num, test_num, dimm_temp, 0xF8);
+                scroll();
+            }
+            if (new_slot) {
+                display_scrolled_message(0, "  -   %4i   %2i   DIMM slot %s", pass_num, test_num, slot_name);
+                scroll();
+            }
+
             set_foreground_colour(YELLOW);
-            display_scrolled_message(0, " %2i   %4i   %2i   %09x%03x (%kB)",
-                                     smp_my_cpu_num(), pass_num, test_num, page, offset, page << 2);
+            if (page != UNKNOWN_PAGE) {
+                display_scrolled_message(0, " %2i   %4i   %2i   %09x%03x (%kB)",
+                                         smp_my_cpu_num(), pass_num, test_num, page, offset, page << 2);
+            } else {
+                display_scrolled_message(0, " %2i   %4i   %2i   unknown address",
+                                         smp_my_cpu_num(), pass_num, test_num);
+            }
             if (type == PARITY_ERROR) {
                 display_scrolled_message(41, "%s", "Parity error detected near this address");
+            } else if (type == ECC_CORRECTED || type == ECC_UNCORRECTED) {
+                display_scrolled_message(41, "ECC %s, syndrome %x", type == ECC_CORRECTED ? "CE" : "UE", good);
             } else {
 #if TESTWORD_WIDTH > 32
                 display_scrolled_message(41, "%016x  %016x", good, bad);
@@ -295,7 +625,7 @@ static void common_err(error_type_t type, uintptr_t addr, testword_t good, testw
         break;
     }
 
-    if (type != PARITY_ERROR) {
+    if (type == ADDR_ERROR || type == DATA_ERROR) {
         error_info.last_addr = addr;
         error_info.last_xor  = xor;
     }
@@ -303,6 +633,11 @@ static void common_err(error_type_t type, uintptr_t addr, testword_t good, testw
     spin_unlock(error_mutex);
 }
 
+static void common_err(error_type_t type, uintptr_t addr, testword_t good, testword_t bad, bool use_for_badram)
+{
+    record_err(type, page_of((void *)addr), addr & (PAGE_SIZE - 1), addr, good, bad, use_for_badram);
+}
+
 //------------------------------------------------------------------------------
 // Public Functions
 //------------------------------------------------------------------------------
@@ -321,8 +656,37 @@ void error_init(void)
     error_info.max_run          = 0;
     error_info.last_addr        = 0;
     error_info.last_xor         = 0;
+    error_info.data_errors      = 0;
+    error_info.decoded_errors   = 0;
+    error_info.located_errors   = 0;
+    error_info.ecc_corrected    = 0;
+    error_info.ecc_uncorrected  = 0;
+    error_info.seed             = 0;
+    error_info.seed_test        = -1;
+    error_info.seed_pass        = -1;
+    error_info.last_slot        = -1;
+    error_info.dimm_temp        = 0;
+    error_info.min_dimm_temp    = 0;
+    error_info.max_dimm_temp    = 0;
+    for (int i = 0; i < MAX_DIMM_SLOTS; i++) {
+        error_info.slot_errors[i] = 0;
+    }
+    for (int ch = 0; ch < IMC_MAX_CHANNELS; ch++) {
+        for (int dimm = 0; dimm < IMC_MAX_DIMMS_PER_CHANNEL; dimm++) {
+            error_info.dimm_errors[ch][dimm] = 0;
+        }
+    }
+    for (int i = 0; i < TESTWORD_WIDTH; i++) {
+        error_info.bit_errors[i] = 0;
+    }
+    for (int i = 0; i < NUM_BYTE_LANES; i++) {
+        error_info.lane_errors[i] = 0;
+    }
+    new_histograms = false;
 
     error_count = 0;
+
+    focus_map_size = 0;
 }
 
 void addr_error(testword_t *addr1, testword_t *addr2, testword_t good, testword_t bad)
@@ -345,6 +709,24 @@ void data_error(testword_t *addr, testword_t good, testword_t bad, bool use_for_
     common_err(DATA_ERROR, (uintptr_t)addr, good, bad, use_for_badram);
 }
 
+void ecc_error(bool addr_valid, uint64_t addr, bool uncorrected, uint64_t syndrome)
+{
+    ecc_status.err_type = uncorrected ? ECC_ERR_UNCORRECTED : ECC_ERR_CORRECTED;
+    ecc_status.err_adr  = addr;
+
+    dram_addr_t dram_addr;
+    if (addr_valid && memctrl_decode_addr(addr, &dram_addr)) {
+        ecc_status.err_col  = dram_addr.col;
+        ecc_status.err_row  = dram_addr.row;
+        ecc_status.err_rank = dram_addr.rank;
+        ecc_status.err_bank = dram_addr.bank;
+    }
+
+    record_err(uncorrected ? ECC_UNCORRECTED : ECC_CORRECTED,
+               addr_valid ? (testword_t)(addr >> PAGE_SHIFT) : UNKNOWN_PAGE,
+               addr & (PAGE_SIZE - 1), 0, syndrome, 0, false);
+}
+
 #if REPORT_PARITY_ERRORS
 void parity_error(void)
 {
@@ -356,6 +738,13 @@ void parity_error(void)
 
 void error_update(void)
 {
+    if (error_mode == ERROR_MODE_SUMMARY && new_histograms) {
+        spin_lock(error_mutex);
+        display_histograms();
+        new_histograms = false;
+        spin_unlock(error_mutex);
+    }
+
     if (error_count > 0) {
         if (error_mode != last_error_mode) {
             common_err(NEW_MODE, 0, 0, 0, false);
@@ -366,7 +755,7 @@ void error_update(void)
                                    test_list[test_num].errors);
         }
         display_error_count(error_count);
-        display_status("Failed!");
+        display_status(focus_mode ? "Focus  " : "Failed!");
 
         // Display FAIL banner on first error
         if (error_count == 1) {
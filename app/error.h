@@ -15,11 +15,34 @@
 
 #include "test.h"
 
+/**
+ * The maximum number of distinct regions recorded for focused re-testing.
+ */
+#define MAX_FOCUS_RANGES    16
+
+/**
+ * A range of physical pages surrounding one or more failing addresses.
+ */
+typedef struct {
+    uintptr_t   start;
+    uintptr_t   end;
+} focus_range_t;
+
 /**
  * The number of errors recorded during the current run.
  */
 extern uint64_t error_count;
 
+/**
+ * The regions surrounding the failing addresses, sorted by address.
+ */
+extern focus_range_t focus_map[MAX_FOCUS_RANGES];
+
+/**
+ * The number of valid entries in focus_map.
+ */
+extern int focus_map_size;
+
 /**
  * Initialises the error records.
  */
@@ -35,6 +58,12 @@ void addr_error(testword_t *addr1, testword_t *addr2, testword_t good, testword_
  */
 void data_error(testword_t *addr, testword_t good, testword_t bad, bool use_for_badram);
 
+/**
+ * Adds an ECC error reported by the hardware (e.g. logged in an MCA bank)
+ * to the error reports. Corrected errors do not count as test failures.
+ */
+void ecc_error(bool addr_valid, uint64_t addr, bool uncorrected, uint64_t syndrome);
+
 #if REPORT_PARITY_ERRORS
 /**
  * Adds a parity error to the error reports.
@@ -0,0 +1,296 @@
+// SPDX-License-Identifier: GPL-2.0
+// Copyright (C) 2004-2023 Sam Demeulemeester.
+//
+// Each record is a single JSON object followed by a line break, with a
+// "type" member naming the record. Addresses and data patterns are sent as
+// hexadecimal strings, as JSON numbers cannot portably hold a 64-bit value.
+//
+// The records are only sent by the master CPU between tests, except for
+// the error records, which are sent under the error lock, so the output of
+// different CPUs is never interleaved.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "cpuinfo.h"
+#include "memctrl.h"
+#include "memsize.h"
+#include "pmem.h"
+#include "serial.h"
+#include "smbus.h"
+#include "smp.h"
+#include "timers.h"
+#include "tsc.h"
+
+#include "build_version.h"
+#include "config.h"
+#include "error.h"
+#include "test.h"
+#include "tests.h"
+
+#include "json.h"
+
+//------------------------------------------------------------------------------
+// Constants
+//------------------------------------------------------------------------------
+
+#define LINE_SIZE       256
+
+#define MAX_STR_LEN     64      // longer strings are truncated
+
+//------------------------------------------------------------------------------
+// Private Variables
+//------------------------------------------------------------------------------
+
+static char         line[LINE_SIZE];
+
+static uint64_t     pass_start_time = 0;
+static uint64_t     pass_start_errors = 0;
+
+static uint64_t     test_start_time = 0;
+static uint64_t     test_start_errors = 0;
+
+//------------------------------------------------------------------------------
+// Private Functions
+//------------------------------------------------------------------------------
+
+static char *append_str(char *p, const char *str)
+{
+    while (*str) {
+        *p++ = *str++;
+    }
+    *p = '\0';
+    return p;
+}
+
+static char *append_u64(char *p, uint64_t value)
+{
+    char digits[20];
+    int n = 0;
+    do {
+        uint64_t next = value / 10;
+        digits[n++] = '0' + (char)(value - next * 10);
+        value = next;
+    } while (value > 0);
+    while (n > 0) {
+        *p++ = digits[--n];
+    }
+    *p = '\0';
+    return p;
+}
+
+static char *append_name(char *p, const char *name)
+{
+    p = append_str(p, ",\"");
+    p = append_str(p, name);
+    return append_str(p, "\":");
+}
+
+static char *append_num(char *p, const char *name, uint64_t value)
+{
+    return append_u64(append_name(p, name), value);
+}
+
+static char *append_hex(char *p, const char *name, uint64_t value)
+{
+    p = append_str(append_name(p, name), "\"0x");
+    int shift = 60;
+    while (shift > 0 && (value >> shift) == 0) {
+        shift -= 4;
+    }
+    for (; shift >= 0; shift -= 4) {
+        *p++ = "0123456789abcdef"[(value >> shift) & 0xf];
+    }
+    return append_str(p, "\"");
+}
+
+static char *append_bool(char *p, const char *name, bool value)
+{
+    return append_str(append_name(p, name), value ? "true" : "false");
+}
+
+static char *append_string(char *p, const char *name, const char *str)
+{
+    p = append_str(append_name(p, name), "\"");
+    for (int i = 0; str != NULL && str[i] != '\0' && i < MAX_STR_LEN; i++) {
+        char c = str[i];
+        if (c == '"' || c == '\\') {
+            *p++ = '\\';
+        } else if (c < ' ' || c > '~') {
+            c = '?';
+        }
+        *p++ = c;
+    }
+    return append_str(p, "\"");
+}
+
+static char *start_record(const char *type)
+{
+    char *p = append_str(line, "{\"type\":\"");
+    p = append_str(p, type);
+    return append_str(p, "\"");
+}
+
+static void send_record(char *p)
+{
+    append_str(p, "}\r\n");
+    serial_echo_print(line);
+}
+
+static uint64_t elapsed_msec(uint64_t start_time)
+{
+    return clks_per_msec ? (get_tsc() - start_time) / clks_per_msec : 0;
+}
+
+static char *append_timings(char *p, uint16_t tCL, uint8_t tCL_dec, uint16_t tRCD, uint16_t tRP, uint16_t tRAS)
+{
+    // The CAS latency may have a half cycle.
+    p = append_name(p, "tCL");
+    p = append_u64(p, tCL);
+    if (tCL_dec != 0) {
+        p = append_str(p, ".5");
+    }
+    p = append_num(p, "tRCD", tRCD);
+    p = append_num(p, "tRP",  tRP);
+    return append_num(p, "tRAS", tRAS);
+}
+
+//------------------------------------------------------------------------------
+// Public Functions
+//------------------------------------------------------------------------------
+
+void json_start_run(void)
+{
+    if (!enable_tty_json) {
+        return;
+    }
+
+    char *p = start_record("start");
+    p = append_string(p, "version", MT_VERSION "." GIT_HASH);
+    p = append_string(p, "cpu", cpu_model);
+    p = append_num(p, "tsc_khz", clks_per_msec);
+    p = append_string(p, "tsc_source", tsc_source);
+    p = append_num(p, "cpus", num_available_cpus);
+    p = append_num(p, "active_cpus", num_enabled_cpus);
+    p = append_num(p, "memory_kb", 1024 * (uint64_t)((num_pm_pages + 128) / 256));
+    send_record(p);
+
+    if (imc.freq) {
+        p = start_record("imc");
+        p = append_string(p, "dram", imc.type);
+        p = append_num(p, "freq", imc.freq);
+        p = append_num(p, "width", imc.width);
+        p = append_timings(p, imc.tCL, imc.tCL_dec, imc.tRCD, imc.tRP, imc.tRAS);
+        send_record(p);
+    }
+
+    for (int i = 0; i < ram.num_modules && i < MAX_SPD_SLOT; i++) {
+        const spd_info *spdi = &spd_modules[i];
+        p = start_record("spd");
+        p = append_num(p, "slot", spdi->slot_num);
+        p = append_string(p, "dram", spdi->type);
+        p = append_num(p, "size_mb", spdi->module_size);
+        p = append_num(p, "freq", spdi->freq);
+        p = append_bool(p, "ecc", spdi->hasECC);
+        p = append_hex(p, "jedec_id", spdi->jedec_code);
+        p = append_string(p, "sku", spdi->sku);
+        p = append_timings(p, spdi->tCL, spdi->tCL_dec, spdi->tRCD, spdi->tRP, spdi->tRAS);
+        send_record(p);
+    }
+}
+
+void json_start_pass(void)
+{
+    if (!enable_tty_json) {
+        return;
+    }
+
+    pass_start_time = get_tsc();
+    pass_start_errors = error_count;
+}
+
+void json_start_test(void)
+{
+    if (!enable_tty_json) {
+        return;
+    }
+
+    char *p = start_record("test_start");
+    p = append_num(p, "pass", pass_num);
+    p = append_num(p, "test", test_num);
+    p = append_hex(p, "seed", test_seed);
+    send_record(p);
+
+    test_start_time = get_tsc();
+    test_start_errors = error_count;
+}
+
+void json_end_test(void)
+{
+    if (!enable_tty_json) {
+        return;
+    }
+
+    char *p = start_record("test_end");
+    p = append_num(p, "pass", pass_num);
+    p = append_num(p, "test", test_num);
+    p = append_num(p, "duration_ms", elapsed_msec(test_start_time));
+    p = append_num(p, "bytes", test_pages_covered << PAGE_SHIFT);
+    p = append_num(p, "errors", error_count - test_start_errors);
+    send_record(p);
+}
+
+void json_end_pass(void)
+{
+    if (!enable_tty_json) {
+        return;
+    }
+
+    // The pass number has already been incremented.
+    char *p = start_record("pass_end");
+    p = append_num(p, "pass", pass_num - 1);
+    p = append_num(p, "duration_ms", elapsed_msec(pass_start_time));
+    p = append_num(p, "errors", error_count - pass_start_errors);
+    p = append_num(p, "total_errors", error_count);
+    send_record(p);
+}
+
+void json_exit(int status, const char *action)
+{
+    if (!enable_tty_json) {
+        return;
+    }
+
+    char *p = start_record("exit");
+    p = append_num(p, "status", status);
+    p = append_string(p, "result", status == 0 ? "pass" : "fail");
+    p = append_num(p, "passes", pass_num);
+    p = append_num(p, "errors", error_count);
+    p = append_string(p, "action", action);
+    send_record(p);
+}
+
+void json_error(const char *kind, bool addr_known, uint64_t addr, const char *slot, testword_t good, testword_t bad)
+{
+    if (!enable_tty_json) {
+        return;
+    }
+
+    char *p = start_record("error");
+    p = append_string(p, "kind", kind);
+    if (addr_known) {
+        p = append_hex(p, "addr", addr);
+    }
+    if (slot != NULL) {
+        p = append_string(p, "slot", slot);
+    }
+    p = append_hex(p, "expected", good);
+    p = append_hex(p, "actual", bad);
+    p = append_hex(p, "xor", good ^ bad);
+    p = append_num(p, "cpu", smp_my_cpu_num());
+    p = append_num(p, "pass", pass_num);
+    p = append_num(p, "test", test_num);
+    p = append_hex(p, "seed", cpu_seed(smp_my_cpu_num()));
+    send_record(p);
+}
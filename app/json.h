@@ -0,0 +1,61 @@
+// SPDX-License-Identifier: GPL-2.0
+#ifndef JSON_H
+#define JSON_H
+/**
+ * \file
+ *
+ * Provides a machine-readable stream of the test results on the serial
+ * console, as one JSON record per line, for use when the serial console
+ * is in JSON mode.
+ *
+ *//*
+ * Copyright (C) 2004-2023 Sam Demeulemeester.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "test.h"
+
+/**
+ * Sends the records describing the hardware under test at the start of a
+ * run.
+ */
+void json_start_run(void);
+
+/**
+ * Records the start time of a pass.
+ */
+void json_start_pass(void);
+
+/**
+ * Sends the record for the start of the current test and records its
+ * start time.
+ */
+void json_start_test(void);
+
+/**
+ * Sends the record for the end of the current test.
+ */
+void json_end_test(void);
+
+/**
+ * Sends the record for the end of the pass just completed.
+ */
+void json_end_pass(void);
+
+/**
+ * Sends the record for the end of the run, giving the exit status and the
+ * action about to be taken.
+ */
+void json_exit(int status, const char *action);
+
+/**
+ * Sends the record for an error. If addr_known is false, addr is ignored.
+ * If slot is not NULL, it names the DIMM slot containing the address. Must
+ * be called with the error lock held.
+ */
+void json_error(const char *kind, bool addr_known, uint64_t addr, const char *slot, testword_t good, testword_t bad);
+
+#endif // JSON_H
@@ -27,6 +27,7 @@
 #include "hwquirks.h"
 #include "io.h"
 #include "keyboard.h"
+#include "mca.h"
 #include "pmem.h"
 #include "memctrl.h"
 #include "memsize.h"
@@ -42,11 +43,17 @@
 #include "unistd.h"
 
 #include "badram.h"
+#include "bench.h"
+#include "budget.h"
 #include "config.h"
 #include "display.h"
 #include "error.h"
+#include "json.h"
+#include "profile.h"
+#include "sample.h"
 #include "test.h"
 
+#include "test_helper.h"
 #include "tests.h"
 
 #include "tsc.h"
@@ -67,6 +74,24 @@
 
 #define HIGH_LOAD_LIMIT     (VM_PINNED_SIZE << PAGE_SHIFT)
 
+#define LOW_IMAGE           0
+#define HIGH_IMAGE          1
+#define NUM_IMAGES          2
+
+// The tests run in focus mode (moving inversions with random and wide
+// patterns, block move, random number sequence, and modulo 20).
+#define FOCUS_TESTS         ((1 << 5) | (1 << 6) | (1 << 7) | (1 << 8) | (1 << 9))
+
+#define FOCUS_ITERATION_SCALE   4
+
+// The exit status at the end of an unattended run, which is also written
+// to the POST diagnostic port (as a more distinctive code).
+#define EXIT_STATUS_PASS    0
+#define EXIT_STATUS_FAIL    1
+
+#define POST_CODE_PASS      0xaa
+#define POST_CODE_FAIL      0xee
+
 //------------------------------------------------------------------------------
 // Private Variables
 //------------------------------------------------------------------------------
@@ -79,6 +104,15 @@ static volatile int     init_state = 0;
 static uintptr_t        low_load_addr;
 static uintptr_t        high_load_addr;
 
+// A copy of the program is left in place when we relocate away from it. If
+// its code and read-only data are unchanged when we return, only the data
+// that may have changed needs to be copied back. The checksum is taken when
+// we leave the copy, and is discarded if the memory it occupies is tested.
+// In a normal run both copies are tested on every pass, so no checksum is
+// taken and the whole program is copied.
+static bool             image_checked[NUM_IMAGES] = { false, false };
+static uintptr_t        image_checksum[NUM_IMAGES];
+
 static barrier_t        *start_barrier = NULL;
 
 static bool             start_run  = false;
@@ -86,7 +120,7 @@ static bool             start_pass = false;
 static bool             start_test = false;
 static bool             rerun_test = false;
 
-static bool             dummy_run  = false;
+static bool             start_bench = false;
 
 static uintptr_t        window_start = 0;
 static uintptr_t        window_end   = 0;
@@ -95,6 +129,17 @@ static size_t           num_mapped_pages = 0;
 
 static int              test_stage = 0;
 
+// The windows containing memory to be tested and the ticks taken by a
+// single sweep over that memory, for window 0 and for the other windows.
+static int              scanned_ratio = SAMPLE_FULL;
+static int              num_test_windows[2];
+static int              num_sweep_ticks[2];
+
+static int              num_passes_run = 0;
+
+// The last window counted in test_pages_covered.
+static int              covered_window = -1;
+
 //------------------------------------------------------------------------------
 // Public Variables
 //------------------------------------------------------------------------------
@@ -120,6 +165,14 @@ int         test_num = 0;
 
 int         window_num = 0;
 
+bool        focus_mode = false;
+bool        partial_window = false;
+bool        windows_scanned = false;
+
+uint64_t    test_pages_covered = 0;
+
+testword_t  test_seed = 0;
+
 bool        restart = false;
 bool        bail    = false;
 
@@ -133,29 +186,110 @@ uintptr_t   test_addr[MAX_CPUS];
     if (TRACE_BARRIERS) { \
         trace(my_cpu, "Start barrier wait at %s line %i", __FILE__, __LINE__); \
     } \
-    if (power_save < POWER_SAVE_HIGH) { \
-        barrier_spin_wait(start_barrier); \
-    } else { \
-        barrier_halt_wait(start_barrier); \
+    { \
+        uint64_t barrier_start_time = profile_start(); \
+        if (power_save < POWER_SAVE_HIGH) { \
+            barrier_spin_wait(start_barrier); \
+        } else { \
+            barrier_halt_wait(start_barrier); \
+        } \
+        profile_end(my_cpu, PROFILE_START_BARRIER, barrier_start_time); \
     }
 
 #define LONG_BARRIER \
     if (TRACE_BARRIERS) { \
         trace(my_cpu, "Start barrier wait at %s line %i", __FILE__, __LINE__); \
     } \
-    if (power_save > POWER_SAVE_OFF) { \
-        barrier_halt_wait(start_barrier); \
-    } else { \
-        barrier_spin_wait(start_barrier); \
+    { \
+        uint64_t barrier_start_time = profile_start(); \
+        if (power_save > POWER_SAVE_OFF) { \
+            barrier_halt_wait(start_barrier); \
+        } else { \
+            barrier_spin_wait(start_barrier); \
+        } \
+        profile_end(my_cpu, PROFILE_START_BARRIER, barrier_start_time); \
+    }
+
+static int image_at(uintptr_t addr)
+{
+    if (addr == low_load_addr) {
+        return LOW_IMAGE;
+    }
+    if (addr == high_load_addr) {
+        return HIGH_IMAGE;
+    }
+    return -1;
+}
+
+static uintptr_t checksum(const uint8_t *image, size_t size)
+{
+    const uintptr_t *p = (const uintptr_t *)image;
+    uintptr_t sum = 0;
+    for (size_t i = 0; i < size / sizeof(uintptr_t); i++) {
+        sum = ((sum << 1) | (sum >> (8 * sizeof(uintptr_t) - 1))) + p[i];
+    }
+    return sum;
+}
+
+// Returns true if the copy of the program at the given image may not be
+// tested before we return to it, so it is worth taking its checksum.
+static bool image_may_survive(int image)
+{
+    if (focus_mode || replay_test >= 0 || sample_ratio < SAMPLE_FULL) {
+        return true;
     }
+    uintptr_t image_pages = (_erodata - _start + PAGE_SIZE - 1) >> PAGE_SHIFT;
+    uintptr_t image_start = (image == LOW_IMAGE ? low_load_addr : high_load_addr) >> PAGE_SHIFT;
+    return image_start + image_pages <= pm_limit_lower || image_start >= pm_limit_upper;
+}
+
+// Discards the checksum of any copy of the program that lies in the memory
+// mapped for testing.
+static void check_image_overlap(void)
+{
+    uintptr_t image_pages = (_erodata - _start + PAGE_SIZE - 1) >> PAGE_SHIFT;
+    for (int i = 0; i < vm_map_size; i++) {
+        uintptr_t seg_start = vm_map[i].pm_base_addr;
+        uintptr_t seg_end   = seg_start + (((vm_map[i].end - vm_map[i].start + 1) * sizeof(testword_t)) >> PAGE_SHIFT);
+        for (int image = 0; image < NUM_IMAGES; image++) {
+            uintptr_t image_start = (image == LOW_IMAGE ? low_load_addr : high_load_addr) >> PAGE_SHIFT;
+            if (seg_start < image_start + image_pages && seg_end > image_start) {
+                image_checked[image] = false;
+            }
+        }
+    }
+}
 
 static void run_at(uintptr_t addr, int my_cpu)
 {
     uintptr_t *new_start_addr = (uintptr_t *)(addr + startup - _start);
 
+    // The profile counters are in pinned memory, so this is recorded in
+    // the counters seen by the relocated program.
+    uint64_t start_time = profile_start();
+
     if (my_cpu == 0) {
-        // Copy the program code and all data except the stacks.
-        memmove((void *)addr, (void *)_start, _stacks - _start);
+        size_t fixed_size = _erodata - _start;
+
+        // This must all be done before copying the data, so the relocated
+        // program sees the same image records.
+        int this_image = image_at((uintptr_t)_start);
+        if (this_image >= 0 && !image_checked[this_image] && image_may_survive(this_image)) {
+            image_checksum[this_image] = checksum(_start, fixed_size);
+            image_checked[this_image] = true;
+        }
+        int new_image = image_at(addr);
+        size_t copy_offset = 0;
+        if (new_image >= 0 && image_checked[new_image]
+        &&  checksum((const uint8_t *)addr, fixed_size) == image_checksum[new_image]) {
+            copy_offset = fixed_size;
+        } else if (new_image >= 0) {
+            image_checked[new_image] = false;
+        }
+
+        // Copy the program code (unless the copy already there is intact)
+        // and all data except the stacks.
+        memmove((void *)(addr + copy_offset), (void *)(_start + copy_offset), _stacks - _start - copy_offset);
         // Copy the thread-local storage.
         size_t locals_offset = _stacks - _start + BSP_STACK_SIZE - LOCALS_SIZE;
         for (int cpu_num = 0; cpu_num < num_available_cpus; cpu_num++) {
@@ -163,7 +297,12 @@ static void run_at(uintptr_t addr, int my_cpu)
             locals_offset += AP_STACK_SIZE;
         }
     }
-    LONG_BARRIER;
+    if (power_save > POWER_SAVE_OFF) {
+        barrier_halt_wait(start_barrier);
+    } else {
+        barrier_spin_wait(start_barrier);
+    }
+    profile_end(my_cpu, PROFILE_RELOCATE, start_time);
 
 #ifndef __x86_64__
     // The 32-bit startup code needs to know where it is located.
@@ -206,6 +345,8 @@ static void global_init(void)
 
     cpuid_init();
 
+    pat_init();
+
     // Nothing before this should access the boot parameters, in case they are located above 4GB.
     // This is the first region we map, so it is guaranteed not to fail.
     boot_params_addr = map_region(boot_params_addr, sizeof(boot_params_t), true);
@@ -238,6 +379,8 @@ static void global_init(void)
 
     memctrl_init();
 
+    mca_init();
+
     tty_init();
 
     smp_init(smp_enabled);
@@ -300,20 +443,27 @@ static void global_init(void)
         trace(0, "ACPI RSDP (v%u.%u) found in %s at %0*x", acpi_config.ver_maj, acpi_config.ver_min, rsdp_source, 2*sizeof(uintptr_t), acpi_config.rsdp_addr);
         trace(0, "ACPI FADT found at %0*x", 2*sizeof(uintptr_t), acpi_config.fadt_addr);
     }
+    trace(0, "TSC frequency %ukHz from %s", clks_per_msec, tsc_source);
     if (!load_addr_ok) {
         trace(0, "Cannot relocate program. Press any key to reboot...");
         while (get_key() == 0) { }
         reboot();
     }
 
+    profile_init();
+
+    sample_init();
+
     start_barrier = smp_alloc_barrier(1);
     run_barrier   = smp_alloc_barrier(1);
 
     error_mutex   = smp_alloc_mutex();
 
     start_run = true;
-    dummy_run = true;
     restart = false;
+
+    // The benchmark is only needed to show its results or to plan a budget.
+    start_bench = enable_bench && (show_bench_results || time_budget > 0);
 }
 
 static void ap_enumerate(int my_cpu)
@@ -340,12 +490,66 @@ static void ap_enumerate(int my_cpu)
     }
 }
 
-static void setup_vm_map(uintptr_t win_start, uintptr_t win_end)
+static int focus_tests(void)
+{
+    // If none of the focus tests are enabled, use all the enabled tests, so
+    // that a focus pass is never empty.
+    for (int test = 0; test < NUM_TEST_PATTERNS; test++) {
+        if (test_list[test].enabled && (FOCUS_TESTS & (1 << test))) {
+            return FOCUS_TESTS;
+        }
+    }
+    return ~0;
+}
+
+static bool test_selected(int test)
+{
+    if (replay_test >= 0) {
+        return test == replay_test;
+    }
+    if (focus_mode && !(focus_tests() & (1 << test))) {
+        return false;
+    }
+    return test_list[test].enabled;
+}
+
+static void add_vm_segment(uintptr_t seg_start, uintptr_t seg_end)
+{
+    if (vm_map_size == MAX_MEM_SEGMENTS) {
+        return;
+    }
+    num_mapped_pages += seg_end - seg_start;
+    vm_map[vm_map_size].pm_base_addr = seg_start;
+    vm_map[vm_map_size].start        = first_word_mapping(seg_start);
+    vm_map[vm_map_size].end          = last_word_mapping(seg_end - 1, sizeof(testword_t));
+    vm_map_size++;
+}
+
+static void set_window_bounds(int window, uintptr_t *win_start, uintptr_t *win_end)
+{
+    switch (window) {
+      case 0:
+        *win_start = 0;
+        *win_end   = (LOW_LOAD_LIMIT >> PAGE_SHIFT);
+        break;
+      case 1:
+        *win_start = (LOW_LOAD_LIMIT >> PAGE_SHIFT);
+        *win_end   = VM_WINDOW_SIZE;
+        break;
+      default:
+        *win_start = (window - 1) * (uintptr_t)VM_WINDOW_SIZE;
+        *win_end   = *win_start + VM_WINDOW_SIZE;
+    }
+}
+
+static void setup_vm_map(uintptr_t win_start, uintptr_t win_end, bool record_sample)
 {
     vm_map_size = 0;
 
     num_mapped_pages = 0;
 
+    partial_window = focus_mode || replay_test >= 0;
+
     // Reduce the window to fit in the user-specified limits.
     if (win_start < pm_limit_lower) {
         win_start = pm_limit_lower;
@@ -353,10 +557,28 @@ static void setup_vm_map(uintptr_t win_start, uintptr_t win_end)
     if (win_end > pm_limit_upper) {
         win_end = pm_limit_upper;
     }
+    if (replay_test >= 0) {
+        if (win_start < replay_start) {
+            win_start = replay_start;
+        }
+        if (win_end > replay_end) {
+            win_end = replay_end;
+        }
+    }
     if (win_start >= win_end) {
         return;
     }
 
+    if (sample_ratio < SAMPLE_FULL && !focus_mode && replay_test < 0) {
+        // Only map the blocks to be tested in this pass.
+        partial_window = true;
+        int num_ranges = sample_window(win_start, win_end, record_sample);
+        for (int i = 0; i < num_ranges; i++) {
+            add_vm_segment(sample_map[i].start, sample_map[i].end);
+        }
+        return;
+    }
+
     // Now initialise the virtual memory map with the intersection
     // of the window and the physical memory segments.
     for (int i = 0; i < pm_map_size; i++) {
@@ -369,11 +591,105 @@ static void setup_vm_map(uintptr_t win_start, uintptr_t win_end)
             seg_end = win_end;
         }
         if (seg_start < seg_end && seg_start < win_end && seg_end > win_start) {
-            num_mapped_pages += seg_end - seg_start;
-            vm_map[vm_map_size].pm_base_addr = seg_start;
-            vm_map[vm_map_size].start        = first_word_mapping(seg_start);
-            vm_map[vm_map_size].end          = last_word_mapping(seg_end - 1, sizeof(testword_t));
-            vm_map_size++;
+            if (!focus_mode) {
+                add_vm_segment(seg_start, seg_end);
+                continue;
+            }
+            // Only map the parts of the segment surrounding the failing addresses.
+            for (int j = 0; j < focus_map_size; j++) {
+                uintptr_t focus_start = focus_map[j].start;
+                uintptr_t focus_end   = focus_map[j].end;
+                if (focus_start < seg_start) {
+                    focus_start = seg_start;
+                }
+                if (focus_end > seg_end) {
+                    focus_end = seg_end;
+                }
+                if (focus_start < focus_end) {
+                    add_vm_segment(focus_start, focus_end);
+                }
+            }
+        }
+    }
+}
+
+static int test_iterations(int test, pass_type_t pass_type)
+{
+    int iterations = test_list[test].iterations;
+    if (focus_mode) {
+        // Hammer the failing regions to confirm and characterise the fault.
+        iterations *= FOCUS_ITERATION_SCALE;
+    } else if (time_budget > 0) {
+        // The plan already allows for the length of each pass.
+        iterations = budget_iterations(test, iterations);
+    } else if (pass_type == FAST_PASS) {
+        // Reduce iterations for a faster first pass.
+        iterations /= 3;
+    }
+    return iterations;
+}
+
+// Counts the windows containing memory to be tested and the ticks taken by
+// a single sweep over that memory, separately for window 0 (which is
+// skipped by the multi-stage tests) and for the other windows.
+static void scan_windows(void)
+{
+    for (int i = 0; i < 2; i++) {
+        num_test_windows[i] = 0;
+        num_sweep_ticks[i]  = 0;
+    }
+    uintptr_t win_start, win_end;
+    int window = 0;
+    do {
+        set_window_bounds(window, &win_start, &win_end);
+        setup_vm_map(win_start, win_end, false);
+        if (num_mapped_pages > 0) {
+            int i = (window > 0) ? 1 : 0;
+            num_test_windows[i]++;
+            for (int j = 0; j < vm_map_size; j++) {
+                testword_t *start = vm_map[j].start;
+                if (window == 0 && j == 0 && !partial_window) {
+                    // As in run_test(), the first window covers all selected lower memory.
+                    start = first_word_mapping(pm_limit_lower);
+                }
+                uintptr_t num_words = vm_map[j].end - start + 1;
+                num_sweep_ticks[i] += (num_words + SPIN_SIZE - 1) / SPIN_SIZE;
+            }
+        }
+        window++;
+    } while (win_end < pm_map[pm_map_size - 1].end);
+
+    windows_scanned = true;
+    scanned_ratio = sample_ratio;
+}
+
+// Calculates the number of ticks each test will take in each type of pass,
+// for the progress bars. The memory map only needs to be scanned again when
+// it has changed, which happens on every pass when sampling.
+static void estimate_ticks(void)
+{
+    if (!windows_scanned || sample_ratio < SAMPLE_FULL || sample_ratio != scanned_ratio) {
+        scan_windows();
+    }
+    for (int pass_type = 0; pass_type < NUM_PASS_TYPES; pass_type++) {
+        ticks_per_pass[pass_type] = 0;
+        for (int test = 0; test < NUM_TEST_PATTERNS; test++) {
+            int ticks = 0;
+            if (test_selected(test)) {
+                int num_windows = num_test_windows[1];
+                int sweep_ticks = num_sweep_ticks[1];
+                if (test_list[test].stages == 1) {
+                    num_windows += num_test_windows[0];
+                    sweep_ticks += num_sweep_ticks[0];
+                }
+                ticks = test_tick_count(test, test_iterations(test, (pass_type_t)pass_type), num_windows, sweep_ticks);
+                if (cpu_mode == SEQ || (cpu_mode == PAR && test_list[test].cpu_mode == SEQ)) {
+                    // The test is run by each CPU in turn.
+                    ticks *= num_enabled_cpus;
+                }
+            }
+            ticks_per_test[pass_type][test] = ticks;
+            ticks_per_pass[pass_type] += ticks;
         }
     }
 }
@@ -383,34 +699,26 @@ static void test_all_windows(int my_cpu)
     bool parallel_test = false;
     bool i_am_master = (my_cpu == master_cpu);
     bool i_am_active = i_am_master;
-    if (!dummy_run) {
-        if (cpu_mode == PAR && test_list[test_num].cpu_mode == PAR) {
-            parallel_test = true;
-            i_am_active = true;
-        }
+    if (cpu_mode == PAR && test_list[test_num].cpu_mode == PAR) {
+        parallel_test = true;
+        i_am_active = true;
     }
     if (i_am_master) {
         num_active_cpus = 1;
-        if (!dummy_run) {
-            if (parallel_test) {
-                num_active_cpus = num_enabled_cpus;
-                if(display_mode == DISPLAY_MODE_NA) {
-                    display_all_active();
-                }
-            } else {
-                if (display_mode == 0) {
-                    display_active_cpu(my_cpu);
-                }
+        if (parallel_test) {
+            num_active_cpus = num_enabled_cpus;
+            if(display_mode == DISPLAY_MODE_NA) {
+                display_all_active();
+            }
+        } else {
+            if (display_mode == 0) {
+                display_active_cpu(my_cpu);
             }
         }
         barrier_reset(run_barrier, num_active_cpus);
     }
 
-    int iterations = test_list[test_num].iterations;
-    if (pass_num == 0) {
-        // Reduce iterations for a faster first pass.
-        iterations /= 3;
-    }
+    int iterations = test_iterations(test_num, pass_num == 0 ? FAST_PASS : FULL_PASS);
 
     // Loop through all possible windows.
     do {
@@ -434,31 +742,20 @@ static void test_all_windows(int my_cpu)
 
         // Relocate if necessary.
         if (window_num > 0) {
-            if (!dummy_run && (uintptr_t)&_start != low_load_addr) {
+            if ((uintptr_t)&_start != low_load_addr) {
                 run_at(low_load_addr, my_cpu);
             }
         } else {
-            if (!dummy_run && (uintptr_t)&_start != high_load_addr) {
+            if ((uintptr_t)&_start != high_load_addr) {
                 run_at(high_load_addr, my_cpu);
             }
         }
 
         if (i_am_master) {
             //trace(my_cpu, "start window %i", window_num);
-            switch (window_num) {
-              case 0:
-                window_start = 0;
-                window_end   = (LOW_LOAD_LIMIT >> PAGE_SHIFT);
-                break;
-              case 1:
-                window_start = (LOW_LOAD_LIMIT >> PAGE_SHIFT);
-                window_end   = VM_WINDOW_SIZE;
-                break;
-              default:
-                window_start = window_end;
-                window_end  += VM_WINDOW_SIZE;
-            }
-            setup_vm_map(window_start, window_end);
+            set_window_bounds(window_num, &window_start, &window_end);
+            setup_vm_map(window_start, window_end, true);
+            check_image_overlap();
         }
         SHORT_BARRIER;
 
@@ -474,17 +771,18 @@ static void test_all_windows(int my_cpu)
             continue;
         }
 
-        if (dummy_run) {
-            if (i_am_master) {
-                ticks_per_test[pass_num][test_num] += run_test(-1, test_num, test_stage, iterations);
-            }
-        } else {
-            if (!map_window(vm_map[0].pm_base_addr)) {
-                // Either there is no PAE or we are at the PAE limit.
-                break;
-            }
-            run_test(my_cpu, test_num, test_stage, iterations);
+        uint64_t start_time = profile_start();
+        if (!map_window(vm_map[0].pm_base_addr)) {
+            // Either there is no PAE or we are at the PAE limit.
+            break;
         }
+        profile_end(my_cpu, PROFILE_MAP_WINDOW, start_time);
+        if (i_am_master && window_num > covered_window) {
+            // Each stage (or master CPU) of a test runs through the windows in order.
+            test_pages_covered += num_mapped_pages;
+            covered_window = window_num;
+        }
+        run_test(my_cpu, test_num, test_stage, iterations);
 
         if (i_am_master) {
             window_num++;
@@ -492,6 +790,17 @@ static void test_all_windows(int my_cpu)
     } while (window_end < pm_map[pm_map_size - 1].end);
 }
 
+static testword_t new_test_seed(void)
+{
+    if (enable_fixed_seed) {
+        return fixed_seed;
+    }
+    if (cpuid_info.flags.rdtsc) {
+        return get_tsc();
+    }
+    return 1 + pass_num;
+}
+
 static void select_next_master(void)
 {
     do {
@@ -499,6 +808,48 @@ static void select_next_master(void)
     } while (cpu_state[master_cpu] == CPU_STATE_DISABLED);
 }
 
+// Reports the result at the end of an unattended run, then takes the
+// selected exit action.
+static void exit_run(void)
+{
+    static const char *action_name[] = { "halt", "reboot", "poweroff" };
+
+    int status = (error_count == 0) ? EXIT_STATUS_PASS : EXIT_STATUS_FAIL;
+
+    post_code(status == EXIT_STATUS_PASS ? POST_CODE_PASS : POST_CODE_FAIL);
+
+    trace(0, "exit status %i after %i passes", status, num_passes_run);
+    clear_footer_message();
+    switch (exit_action) {
+      case EXIT_REBOOT:
+        display_footer_message("Done - rebooting...");
+        break;
+      case EXIT_POWEROFF:
+        display_footer_message("Done - powering off...");
+        break;
+      default:
+        display_footer_message("Done - halted");
+        break;
+    }
+    tty_send_region(ROW_FOOTER, 0, ROW_FOOTER, SCREEN_WIDTH - 1);
+    json_exit(status, action_name[exit_action]);
+
+    // Make sure the result has been sent before the serial port goes away.
+    tty_flush();
+
+    switch (exit_action) {
+      case EXIT_REBOOT:
+        reboot();
+        break;
+      case EXIT_POWEROFF:
+        poweroff();
+        break;
+      default:
+        break;
+    }
+    halt();
+}
+
 //------------------------------------------------------------------------------
 // Public Functions
 //------------------------------------------------------------------------------
@@ -537,6 +888,7 @@ void main(void)
             }
             init_state = 2;
         } else {
+            pat_init();
             trace(my_cpu, "AP started");
             cpu_state[my_cpu] = CPU_STATE_RUNNING;
             ap_enumerate(my_cpu);
@@ -552,6 +904,33 @@ void main(void)
     }
 #endif
 
+    if (start_bench) {
+        // Measure the memory bandwidth using all the enabled CPUs at once.
+        bool bench_ok = stream_bench(my_cpu, start_barrier);
+        bool numa_ok  = show_bench_results && numa_bench(my_cpu, start_barrier);
+        if (my_cpu == 0) {
+            start_bench = false;
+            if (bench_ok && show_bench_results) {
+                if (!enable_trace) {
+                    clear_message_area();
+                }
+                display_stream_results();
+                if (latency_bench()) {
+                    display_latency_results();
+                }
+                if (numa_ok) {
+                    display_numa_results();
+                }
+                scroll();
+                display_scrolled_message(0, "Press any key to start testing...");
+                while (get_key() == 0) { }
+                if (!enable_trace) {
+                    clear_message_area();
+                }
+            }
+        }
+    }
+
     // Due to the need to relocate ourselves in the middle of tests, the following
     // code cannot be written in the natural way as a set of nested loops. So we
     // have a single loop and use global state variables to allow us to restart
@@ -563,29 +942,40 @@ void main(void)
             if (start_run) {
                 pass_num = 0;
                 start_pass = true;
-                if (!dummy_run) {
-                    display_start_run();
-                    badram_init();
-                    error_init();
+                if (replay_test >= 0) {
+                    pass_num = replay_pass;
                 }
+                display_start_run();
+                badram_init();
+                error_init();
+                profile_reset();
+                sample_reset();
+                json_start_run();
+                num_passes_run = 0;
             }
             if (start_pass) {
                 test_num = 0;
                 start_test = true;
-                if (dummy_run) {
-                    ticks_per_pass[pass_num] = 0;
-                } else {
-                    display_start_pass();
+                sample_start_pass();
+                estimate_ticks();
+                if (budget_plan()) {
+                    // Re-estimate the pass lengths for the planned iterations and sampling.
+                    estimate_ticks();
                 }
+                display_start_pass();
+                json_start_pass();
             }
             if (start_test) {
                 trace(my_cpu, "start test %i", test_num);
                 test_stage = 0;
                 rerun_test = true;
-                if (dummy_run) {
-                    ticks_per_test[pass_num][test_num] = 0;
-                } else if (test_list[test_num].enabled) {
+                if (test_selected(test_num)) {
+                    test_seed = new_test_seed();
+                    trace(my_cpu, "test %i seed %x", test_num, test_seed);
+                    test_pages_covered = 0;
+                    covered_window = -1;
                     display_start_test();
+                    json_start_test();
                 }
                 bail = false;
             }
@@ -600,26 +990,35 @@ void main(void)
             rerun_test = false;
         }
         SHORT_BARRIER;
-        if (test_list[test_num].enabled) {
+        if (test_selected(test_num)) {
+            uint64_t start_time = profile_start();
+            profile_events_start();
             test_all_windows(my_cpu);
+            profile_events_end(my_cpu);
+            profile_end(my_cpu, PROFILE_TEST, start_time);
         }
         SHORT_BARRIER;
         if (my_cpu != 0) {
             continue;
         }
+        if (test_selected(test_num)) {
+            profile_end_test();
+        }
 
         check_input();
         if (restart) {
             // The configuration has been changed.
             master_cpu = 0;
             start_run = true;
-            dummy_run = true;
             restart = false;
+            budget_reset();
+            focus_mode = false;
+            windows_scanned = false;
             continue;
         }
         error_update();
 
-        if (test_list[test_num].enabled) {
+        if (test_selected(test_num)) {
             if (++test_stage < test_list[test_num].stages) {
                 rerun_test = true;
                 continue;
@@ -651,8 +1050,9 @@ void main(void)
             }
         }
 
-        if (dummy_run) {
-            ticks_per_pass[pass_num] += ticks_per_test[pass_num][test_num];
+        if (test_selected(test_num)) {
+            budget_end_test();
+            json_end_test();
         }
 
         start_test = true;
@@ -662,21 +1062,30 @@ void main(void)
         }
 
         pass_num++;
-        if (dummy_run && pass_num == NUM_PASS_TYPES) {
-            start_run = true;
-            dummy_run = false;
-            continue;
-        }
 
         start_pass = true;
-        if (!dummy_run) {
-            display_pass_count(pass_num);
-            if (error_count == 0) {
-                display_status("Pass   ");
-                display_big_status(true);
-            } else {
-                display_big_status(false);
-            }
+        sample_end_pass();
+        profile_report();
+        budget_report();
+        sample_report();
+        json_end_pass();
+        display_pass_count(pass_num);
+        if (error_count == 0) {
+            display_status("Pass   ");
+            display_big_status(true);
+        } else {
+            display_big_status(false);
+        }
+        if (num_passes > 0 && ++num_passes_run >= num_passes) {
+            exit_run();
+        }
+        if (enable_focus && !focus_mode && focus_map_size > 0) {
+            // Continue with the focused tests, keeping the error records.
+            // The pass length is re-estimated for the reduced memory map.
+            trace(my_cpu, "entering focus mode, %i regions", focus_map_size);
+            focus_mode = true;
+            windows_scanned = false;
+            display_status("Focus  ");
         }
     }
 }
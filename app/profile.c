@@ -0,0 +1,353 @@
+// SPDX-License-Identifier: GPL-2.0
+// Copyright (C) 2004-2023 Sam Demeulemeester.
+//
+// The per-CPU counters are accumulated with the TSC around each barrier
+// wait, cache flush, window mapping, relocation, and master CPU tick. The
+// bytes processed are counted each time a CPU calculates the chunk of a
+// segment it is to sweep. At the end of each test the master CPU adds the
+// counters to the per-test and per-CPU pass totals, and at the end of each
+// pass these are displayed and sent to the serial console.
+//
+// Where the CPU supports it, the core performance monitoring counters are
+// also sampled over each test. The DRAM traffic achieved by a test is taken
+// to be one cache line per LLC miss, and is shown as a percentage of the
+// bytes swept (the traffic the test would generate if no access hit in the
+// caches).
+//
+// On each tick, every CPU also samples its thermal throttle flags and its
+// effective frequency, so that a test whose throughput has dropped can be
+// seen to have been throttled.
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "cpuinfo.h"
+#include "heap.h"
+#include "memctrl.h"
+#include "serial.h"
+#include "smp.h"
+#include "throttle.h"
+#include "tsc.h"
+#include "vmem.h"
+
+#include "config.h"
+#include "display.h"
+#include "error.h"
+#include "test.h"
+
+#include "tests.h"
+
+#include "profile.h"
+
+//------------------------------------------------------------------------------
+// Constants
+//------------------------------------------------------------------------------
+
+#define LINE_SIZE   256
+
+#define CACHE_LINE_SIZE 64
+
+//------------------------------------------------------------------------------
+// Private Variables
+//------------------------------------------------------------------------------
+
+static const char *phase_name[NUM_PROFILE_PHASES] = {
+    "test", "run_barrier", "start_barrier", "cache_flush", "map_window", "relocate", "tick"
+};
+
+static const char *event_name[NUM_PMU_EVENTS] = {
+    "loads", "stores", "llc_misses", "stall_cycles"
+};
+
+static profile_counts_t *cpu_pass = NULL;
+
+static profile_counts_t test_pass[NUM_TEST_PATTERNS];
+
+static uint64_t test_wall[NUM_TEST_PATTERNS];
+
+//------------------------------------------------------------------------------
+// Public Variables
+//------------------------------------------------------------------------------
+
+profile_counts_t *cpu_profile = NULL;
+
+//------------------------------------------------------------------------------
+// Private Functions
+//------------------------------------------------------------------------------
+
+static void clear_counts(profile_counts_t *counts)
+{
+    counts->bytes = 0;
+    for (int phase = 0; phase < NUM_PROFILE_PHASES; phase++) {
+        counts->cycles[phase] = 0;
+    }
+    for (int event = 0; event < NUM_PMU_EVENTS; event++) {
+        counts->events[event] = 0;
+    }
+    counts->throttles = 0;
+    counts->min_khz = 0;
+    counts->max_khz = 0;
+}
+
+static void add_freq(profile_counts_t *counts, uint32_t min_khz, uint32_t max_khz)
+{
+    if (min_khz != 0 && (counts->min_khz == 0 || min_khz < counts->min_khz)) {
+        counts->min_khz = min_khz;
+    }
+    if (max_khz > counts->max_khz) {
+        counts->max_khz = max_khz;
+    }
+}
+
+static void add_counts(profile_counts_t *total, const profile_counts_t *counts)
+{
+    total->bytes += counts->bytes;
+    for (int phase = 0; phase < NUM_PROFILE_PHASES; phase++) {
+        total->cycles[phase] += counts->cycles[phase];
+    }
+    for (int event = 0; event < NUM_PMU_EVENTS; event++) {
+        total->events[event] += counts->events[event];
+    }
+    total->throttles += counts->throttles;
+    add_freq(total, counts->min_khz, counts->max_khz);
+}
+
+static uint64_t kernel_cycles(const profile_counts_t *counts)
+{
+    uint64_t other_cycles = 0;
+    for (int phase = PROFILE_TEST + 1; phase < NUM_PROFILE_PHASES; phase++) {
+        other_cycles += counts->cycles[phase];
+    }
+    return counts->cycles[PROFILE_TEST] > other_cycles ? counts->cycles[PROFILE_TEST] - other_cycles : 0;
+}
+
+static int percent(uint64_t cycles, uint64_t total_cycles)
+{
+    return total_cycles ? (cycles * 100) / total_cycles : 0;
+}
+
+static char *append_str(char *p, const char *str)
+{
+    while (*str) {
+        *p++ = *str++;
+    }
+    *p = '\0';
+    return p;
+}
+
+static char *append_u64(char *p, uint64_t value)
+{
+    char digits[20];
+    int n = 0;
+    do {
+        uint64_t next = value / 10;
+        digits[n++] = '0' + (char)(value - next * 10);
+        value = next;
+    } while (value > 0);
+    while (n > 0) {
+        *p++ = digits[--n];
+    }
+    *p = '\0';
+    return p;
+}
+
+static char *append_field(char *p, const char *name, uint64_t value)
+{
+    p = append_str(p, " ");
+    p = append_str(p, name);
+    p = append_str(p, "=");
+    return append_u64(p, value);
+}
+
+static char *append_counts(char *p, const profile_counts_t *counts)
+{
+    p = append_field(p, "bytes", counts->bytes);
+    p = append_field(p, "kernel", kernel_cycles(counts));
+    for (int phase = 0; phase < NUM_PROFILE_PHASES; phase++) {
+        p = append_field(p, phase_name[phase], counts->cycles[phase]);
+    }
+    for (int event = 0; event < NUM_PMU_EVENTS; event++) {
+        if (pmu_event_supported(event)) {
+            p = append_field(p, event_name[event], counts->events[event]);
+        }
+    }
+    if (throttle_status_supported()) {
+        p = append_field(p, "throttles", counts->throttles);
+    }
+    if (throttle_freq_supported()) {
+        p = append_field(p, "min_khz", counts->min_khz);
+        p = append_field(p, "max_khz", counts->max_khz);
+    }
+    return append_str(p, "\r\n");
+}
+
+static void dump_report(void)
+{
+    char line[LINE_SIZE];
+    char *p;
+
+    tty_clear_screen();
+
+    for (int test = 0; test < NUM_TEST_PATTERNS; test++) {
+        if (test_pass[test].cycles[PROFILE_TEST] == 0) continue;
+        p = append_field(append_str(line, "profile"), "pass", pass_num);
+        p = append_field(p, "test", test);
+        p = append_field(p, "wall", test_wall[test]);
+        append_counts(p, &test_pass[test]);
+        serial_echo_print(line);
+    }
+    for (int cpu = 0; cpu < num_available_cpus; cpu++) {
+        if (cpu_pass[cpu].cycles[PROFILE_TEST] == 0) continue;
+        p = append_field(append_str(line, "profile"), "pass", pass_num);
+        p = append_field(p, "cpu", cpu);
+        append_counts(p, &cpu_pass[cpu]);
+        serial_echo_print(line);
+    }
+
+    tty_full_redraw();
+}
+
+static void display_report(void)
+{
+    clear_message_area();
+    display_pinned_message(0, 0, "Pass %i profile (%% of CPU time)", pass_num);
+    display_pinned_message(1, 0, "Test Time(s)   MB/s Kernel RunBar StartBar Flush  Other  DRAM Stall  Peak  Thr");
+
+    uint16_t width, freq;
+    uint32_t peak_bw = memctrl_peak_bandwidth(&width, &freq);
+
+    int row = 2;
+    for (int test = 0; test < NUM_TEST_PATTERNS; test++) {
+        const profile_counts_t *counts = &test_pass[test];
+        uint64_t total_cycles = counts->cycles[PROFILE_TEST];
+        if (total_cycles == 0) continue;
+
+        uint64_t wall_ms = test_wall[test] / clks_per_msec;
+        uintptr_t tenths = wall_ms / 100;
+        uintptr_t mb_per_sec = wall_ms ? (counts->bytes / wall_ms) / 1000 : 0;
+
+        display_pinned_message(row, 0, "%4i %5u.%u %6u", test, tenths / 10, tenths % 10, mb_per_sec);
+        display_pinned_message(row, 22, "%5i%%", percent(kernel_cycles(counts), total_cycles));
+        display_pinned_message(row, 29, "%5i%%", percent(counts->cycles[PROFILE_RUN_BARRIER],   total_cycles));
+        display_pinned_message(row, 38, "%5i%%", percent(counts->cycles[PROFILE_START_BARRIER], total_cycles));
+        display_pinned_message(row, 44, "%5i%%", percent(counts->cycles[PROFILE_CACHE_FLUSH],   total_cycles));
+        uint64_t other_cycles = counts->cycles[PROFILE_MAP_WINDOW] + counts->cycles[PROFILE_TICK]
+                              + counts->cycles[PROFILE_RELOCATE];
+        display_pinned_message(row, 51, "%5i%%", percent(other_cycles, total_cycles));
+        if (pmu_event_supported(PMU_LLC_MISSES)) {
+            uint64_t dram_bytes = counts->events[PMU_LLC_MISSES] * CACHE_LINE_SIZE;
+            display_pinned_message(row, 58, "%5i%%", percent(dram_bytes, counts->bytes));
+        }
+        if (pmu_event_supported(PMU_STALL_CYCLES)) {
+            display_pinned_message(row, 64, "%5i%%", percent(counts->events[PMU_STALL_CYCLES], total_cycles));
+        }
+        if (peak_bw > 0 && wall_ms > 0) {
+            display_pinned_message(row, 70, "%5i%%", percent(counts->bytes / wall_ms, peak_bw));
+        }
+        if (throttle_status_supported()) {
+            display_pinned_message(row, 76, "%3u", (uintptr_t)counts->throttles);
+        }
+        row++;
+    }
+
+    if (throttle_freq_supported() || throttle_status_supported()) {
+        profile_counts_t total;
+        clear_counts(&total);
+        for (int cpu = 0; cpu < num_available_cpus; cpu++) {
+            add_counts(&total, &cpu_pass[cpu]);
+        }
+        if (throttle_freq_supported() && total.min_khz != 0) {
+            display_pinned_message(row, 0, "Effective frequency %u-%uMHz",
+                                   (uintptr_t)(total.min_khz / 1000), (uintptr_t)(total.max_khz / 1000));
+        }
+        if (throttle_status_supported()) {
+            display_pinned_message(row, 40, "%u throttle events", (uintptr_t)total.throttles);
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+// Public Functions
+//------------------------------------------------------------------------------
+
+void profile_init(void)
+{
+    cpu_profile = NULL;
+    if (!enable_profile || clks_per_msec == 0) {
+        return;
+    }
+
+    pmu_init();
+
+    throttle_init();
+
+    size_t size = num_available_cpus * sizeof(profile_counts_t);
+    uintptr_t addr = heap_alloc(HEAP_TYPE_HM_1, 2 * size, sizeof(uint64_t));
+    if (addr == 0) {
+        return;
+    }
+    // The heap may lie in the part of the address space that map_window()
+    // reuses for each test window, so give the counters a permanent mapping.
+    addr = map_region(addr, 2 * size, false);
+    if (addr == 0) {
+        return;
+    }
+    cpu_pass = (profile_counts_t *)(addr + size);
+    cpu_profile = (profile_counts_t *)addr;
+    profile_reset();
+}
+
+void profile_reset(void)
+{
+    if (cpu_profile == NULL) {
+        return;
+    }
+    for (int test = 0; test < NUM_TEST_PATTERNS; test++) {
+        clear_counts(&test_pass[test]);
+        test_wall[test] = 0;
+    }
+    for (int cpu = 0; cpu < num_available_cpus; cpu++) {
+        clear_counts(&cpu_profile[cpu]);
+        clear_counts(&cpu_pass[cpu]);
+    }
+}
+
+void profile_tick(int my_cpu)
+{
+    if (cpu_profile == NULL || my_cpu < 0) {
+        return;
+    }
+    uint32_t eff_khz;
+    cpu_profile[my_cpu].throttles += throttle_poll(my_cpu, &eff_khz);
+    add_freq(&cpu_profile[my_cpu], eff_khz, eff_khz);
+}
+
+void profile_end_test(void)
+{
+    if (cpu_profile == NULL) {
+        return;
+    }
+    // CPU 0 runs through every test, so its time is the elapsed time.
+    test_wall[test_num] += cpu_profile[0].cycles[PROFILE_TEST];
+
+    for (int cpu = 0; cpu < num_available_cpus; cpu++) {
+        add_counts(&test_pass[test_num], &cpu_profile[cpu]);
+        add_counts(&cpu_pass[cpu], &cpu_profile[cpu]);
+        clear_counts(&cpu_profile[cpu]);
+    }
+}
+
+void profile_report(void)
+{
+    if (cpu_profile == NULL) {
+        return;
+    }
+    // Don't hide any error reports.
+    if (error_count == 0 && !enable_trace) {
+        display_report();
+    }
+    if (enable_tty && !enable_tty_json) {
+        dump_report();
+    }
+    profile_reset();
+}
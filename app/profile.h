@@ -0,0 +1,133 @@
+// SPDX-License-Identifier: GPL-2.0
+#ifndef PROFILE_H
+#define PROFILE_H
+/**
+ * \file
+ *
+ * Provides per-CPU instrumentation of where the time is spent while running
+ * the memory tests, and a report of the results at the end of each pass.
+ *
+ *//*
+ * Copyright (C) 2004-2023 Sam Demeulemeester.
+ */
+
+#include <stdint.h>
+
+#include "pmu.h"
+#include "tsc.h"
+
+/**
+ * The phases of a test that are separately timed. The time spent in the
+ * test kernels is the time spent in the test less the time spent in all
+ * the other phases.
+ */
+typedef enum {
+    PROFILE_TEST,
+    PROFILE_RUN_BARRIER,
+    PROFILE_START_BARRIER,
+    PROFILE_CACHE_FLUSH,
+    PROFILE_MAP_WINDOW,
+    PROFILE_RELOCATE,
+    PROFILE_TICK,
+    NUM_PROFILE_PHASES
+} profile_phase_t;
+
+/**
+ * The counters accumulated by each CPU.
+ */
+typedef struct {
+    uint64_t    bytes;
+    uint64_t    cycles[NUM_PROFILE_PHASES];
+    uint64_t    events[NUM_PMU_EVENTS];
+    uint64_t    throttles;
+    uint32_t    min_khz;
+    uint32_t    max_khz;
+} profile_counts_t;
+
+/**
+ * The counters for the current test, indexed by CPU number, or NULL if
+ * profiling is disabled. These are held in pinned memory, so they are not
+ * disturbed when the program relocates itself.
+ */
+extern profile_counts_t *cpu_profile;
+
+/**
+ * Returns the start time for a timed phase.
+ */
+static inline uint64_t profile_start(void)
+{
+    return cpu_profile ? get_tsc() : 0;
+}
+
+/**
+ * Adds the time since start_time to the given phase for my_cpu.
+ */
+static inline void profile_end(int my_cpu, profile_phase_t phase, uint64_t start_time)
+{
+    if (cpu_profile && my_cpu >= 0) {
+        cpu_profile[my_cpu].cycles[phase] += get_tsc() - start_time;
+    }
+}
+
+/**
+ * Adds the given number of bytes to the bytes processed by my_cpu.
+ */
+static inline void profile_bytes(int my_cpu, uint64_t bytes)
+{
+    if (cpu_profile && my_cpu >= 0) {
+        cpu_profile[my_cpu].bytes += bytes;
+    }
+}
+
+/**
+ * Starts the performance monitoring counters of the calling CPU for a test.
+ */
+static inline void profile_events_start(void)
+{
+    if (cpu_profile) {
+        pmu_start();
+    }
+}
+
+/**
+ * Stops the performance monitoring counters of my_cpu and adds their
+ * values to its counters for the current test.
+ */
+static inline void profile_events_end(int my_cpu)
+{
+    if (cpu_profile) {
+        pmu_stop(cpu_profile[my_cpu].events);
+    }
+}
+
+/**
+ * Samples the throttle status flags and the effective frequency of my_cpu
+ * and adds them to its counters for the current test.
+ */
+void profile_tick(int my_cpu);
+
+/**
+ * Allocates the profile counters if profiling is enabled. Must be called
+ * after the SMP initialisation.
+ */
+void profile_init(void);
+
+/**
+ * Clears the counters for the current test and the pass totals.
+ */
+void profile_reset(void);
+
+/**
+ * Adds the counters of all CPUs for the current test to the pass totals
+ * for that test and clears them. Must only be called when no other
+ * CPU is running a test.
+ */
+void profile_end_test(void);
+
+/**
+ * Displays a summary of the totals for the pass just completed and sends a
+ * full dump of them to the serial console, then clears them.
+ */
+void profile_report(void);
+
+#endif // PROFILE_H
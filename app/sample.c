@@ -0,0 +1,327 @@
+// SPDX-License-Identifier: GPL-2.0
+// Copyright (C) 2004-2023 Sam Demeulemeester.
+//
+// The memory in each window is divided into 2MB blocks, and the blocks are
+// divided into (at most) MAX_SAMPLE_RANGES strata of equal size, so that
+// the sample is spread evenly through the window. From each stratum, a run
+// of consecutive blocks is taken, starting at a pseudo-randomly chosen
+// block and skipping any blocks that have already been tested. The choice
+// depends only on the pass number and the blocks already tested, so every
+// test in a pass tests the same blocks.
+//
+// The blocks tested in each pass are recorded in a bitmap, which is merged
+// into the bitmap of blocks tested in the current round at the end of the
+// pass. Once every block in a window has been tested, a new round starts
+// for that window.
+//
+// In a quick pass, the fraction of the memory tested doubles on each pass
+// until the whole of the memory is tested, so a grossly faulty module is
+// found in the first pass and the coverage is complete after a few passes.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "heap.h"
+#include "memsize.h"
+#include "pmem.h"
+#include "vmem.h"
+
+#include "config.h"
+#include "display.h"
+#include "error.h"
+#include "test.h"
+
+#include "sample.h"
+
+//------------------------------------------------------------------------------
+// Constants
+//------------------------------------------------------------------------------
+
+#define QUICK_PASS_STEPS    4       // the ratio doubles on each pass until it reaches SAMPLE_FULL
+
+#define BITS_PER_WORD       (8 * sizeof(uintptr_t))
+
+//------------------------------------------------------------------------------
+// Private Variables
+//------------------------------------------------------------------------------
+
+static uintptr_t    *tested_map = NULL;     // blocks tested in the current round
+static uintptr_t    *pass_map   = NULL;     // blocks tested in the current pass
+static uintptr_t    num_map_words = 0;
+
+static pm_map_t     pieces[MAX_MEM_SEGMENTS];
+static int          num_pieces = 0;
+
+static bool         new_round = false;
+
+static int          pass_coverage = 0;
+
+//------------------------------------------------------------------------------
+// Public Variables
+//------------------------------------------------------------------------------
+
+int sample_ratio = SAMPLE_FULL;
+
+pm_map_t sample_map[MAX_SAMPLE_RANGES];
+
+//------------------------------------------------------------------------------
+// Private Functions
+//------------------------------------------------------------------------------
+
+static bool test_bit(const uintptr_t *map, uintptr_t block)
+{
+    return map != NULL && (map[block / BITS_PER_WORD] >> (block % BITS_PER_WORD)) & 1;
+}
+
+static void set_bit(uintptr_t *map, uintptr_t block)
+{
+    if (map != NULL) {
+        map[block / BITS_PER_WORD] |= (uintptr_t)1 << (block % BITS_PER_WORD);
+    }
+}
+
+static void clear_bit(uintptr_t *map, uintptr_t block)
+{
+    if (map != NULL) {
+        map[block / BITS_PER_WORD] &= ~((uintptr_t)1 << (block % BITS_PER_WORD));
+    }
+}
+
+static int count_bits(uintptr_t word)
+{
+    int count = 0;
+    while (word != 0) {
+        word &= word - 1;
+        count++;
+    }
+    return count;
+}
+
+static uintptr_t first_block(const pm_map_t *piece)
+{
+    return piece->start / SAMPLE_BLOCK_SIZE;
+}
+
+static uintptr_t end_block(const pm_map_t *piece)
+{
+    return (piece->end + SAMPLE_BLOCK_SIZE - 1) / SAMPLE_BLOCK_SIZE;
+}
+
+static bool untested(uintptr_t block)
+{
+    return new_round || !test_bit(tested_map, block);
+}
+
+// Returns the block with the given index in the list of blocks in the
+// current window, and the piece of memory it lies in.
+static uintptr_t block_at(uintptr_t index, int *piece)
+{
+    for (int i = 0; i < num_pieces; i++) {
+        uintptr_t count = end_block(&pieces[i]) - first_block(&pieces[i]);
+        if (index < count) {
+            *piece = i;
+            return first_block(&pieces[i]) + index;
+        }
+        index -= count;
+    }
+    *piece = -1;
+    return 0;
+}
+
+static uint32_t block_hash(uintptr_t block)
+{
+    uint32_t hash = (uint32_t)block * 0x9e3779b1 ^ (uint32_t)pass_num * 0x85ebca6b;
+    hash ^= hash >> 15;
+    hash *= 0x2c1b3c6d;
+    hash ^= hash >> 12;
+    return hash;
+}
+
+static uintptr_t collect_pieces(uintptr_t win_start, uintptr_t win_end)
+{
+    uintptr_t num_blocks = 0;
+    num_pieces = 0;
+    for (int i = 0; i < pm_map_size; i++) {
+        uintptr_t seg_start = pm_map[i].start > win_start ? pm_map[i].start : win_start;
+        uintptr_t seg_end   = pm_map[i].end   < win_end   ? pm_map[i].end   : win_end;
+        if (seg_start < seg_end) {
+            pieces[num_pieces].start = seg_start;
+            pieces[num_pieces].end   = seg_end;
+            num_blocks += end_block(&pieces[num_pieces]) - first_block(&pieces[num_pieces]);
+            num_pieces++;
+        }
+    }
+    return num_blocks;
+}
+
+//------------------------------------------------------------------------------
+// Public Functions
+//------------------------------------------------------------------------------
+
+void sample_init(void)
+{
+    tested_map = NULL;
+    pass_map   = NULL;
+    if (pm_map_size == 0) {
+        return;
+    }
+
+    uintptr_t num_blocks = (pm_map[pm_map_size - 1].end + SAMPLE_BLOCK_SIZE - 1) / SAMPLE_BLOCK_SIZE;
+    num_map_words = (num_blocks + BITS_PER_WORD - 1) / BITS_PER_WORD;
+    size_t map_size = 2 * num_map_words * sizeof(uintptr_t);
+    uintptr_t addr = heap_alloc(HEAP_TYPE_HM_1, map_size, sizeof(uintptr_t));
+    if (addr != 0) {
+        // The bitmap is updated before the next window is mapped, so it must
+        // not be reached through the test window's part of the address space.
+        addr = map_region(addr, map_size, false);
+    }
+    if (addr == 0) {
+        // Carry on without the coverage record. Blocks may then be repeated.
+        return;
+    }
+    tested_map = (uintptr_t *)addr;
+    pass_map   = tested_map + num_map_words;
+    sample_reset();
+}
+
+void sample_reset(void)
+{
+    if (tested_map == NULL) {
+        return;
+    }
+    for (uintptr_t i = 0; i < num_map_words; i++) {
+        tested_map[i] = 0;
+        pass_map[i]   = 0;
+    }
+    pass_coverage = 0;
+}
+
+void sample_start_pass(void)
+{
+    if (!enable_quick_pass || time_budget > 0) {
+        // The budget plan sets the ratio.
+        return;
+    }
+    sample_ratio = SAMPLE_FULL;
+    if (pass_num < QUICK_PASS_STEPS && !focus_mode && replay_test < 0) {
+        sample_ratio = SAMPLE_FULL >> (QUICK_PASS_STEPS - pass_num);
+    }
+}
+
+int sample_window(uintptr_t win_start, uintptr_t win_end, bool record)
+{
+    uintptr_t num_blocks = collect_pieces(win_start, win_end);
+    if (num_blocks == 0) {
+        return 0;
+    }
+
+    // Start a new round once every block in the window has been tested.
+    new_round = tested_map != NULL;
+    for (int i = 0; i < num_pieces && new_round; i++) {
+        for (uintptr_t block = first_block(&pieces[i]); block < end_block(&pieces[i]); block++) {
+            if (!test_bit(tested_map, block)) {
+                new_round = false;
+                break;
+            }
+        }
+    }
+    if (new_round && record) {
+        for (int i = 0; i < num_pieces; i++) {
+            for (uintptr_t block = first_block(&pieces[i]); block < end_block(&pieces[i]); block++) {
+                clear_bit(tested_map, block);
+            }
+        }
+    }
+
+    uintptr_t num_sampled = (num_blocks * sample_ratio + SAMPLE_FULL - 1) / SAMPLE_FULL;
+    uintptr_t num_strata  = num_sampled < MAX_SAMPLE_RANGES ? num_sampled : MAX_SAMPLE_RANGES;
+    uintptr_t run_length  = (num_sampled + num_strata - 1) / num_strata;
+
+    int num_ranges = 0;
+    for (uintptr_t stratum = 0; stratum < num_strata; stratum++) {
+        uintptr_t lo = (stratum * num_blocks) / num_strata;
+        uintptr_t hi = ((stratum + 1) * num_blocks) / num_strata;
+        if (lo == hi) continue;
+
+        // Find the first untested block at or after a pseudo-random start.
+        int piece;
+        uintptr_t length = hi - lo;
+        uintptr_t offset = block_hash(block_at(lo, &piece)) % length;
+        uintptr_t index  = hi;
+        for (uintptr_t i = 0; i < length; i++) {
+            uintptr_t try_index = lo + (offset + i) % length;
+            if (untested(block_at(try_index, &piece))) {
+                index = try_index;
+                break;
+            }
+        }
+        if (index == hi) continue;
+
+        // Extend the run over the following untested blocks in the same piece.
+        uintptr_t start_block = block_at(index, &piece);
+        uintptr_t last_block  = start_block;
+        while (++index < hi && last_block + 1 - start_block < run_length) {
+            int next_piece;
+            uintptr_t next_block = block_at(index, &next_piece);
+            if (next_piece != piece || !untested(next_block)) break;
+            last_block = next_block;
+        }
+
+        uintptr_t range_start = start_block * SAMPLE_BLOCK_SIZE;
+        uintptr_t range_end   = (last_block + 1) * SAMPLE_BLOCK_SIZE;
+        sample_map[num_ranges].start = range_start > pieces[piece].start ? range_start : pieces[piece].start;
+        sample_map[num_ranges].end   = range_end   < pieces[piece].end   ? range_end   : pieces[piece].end;
+        num_ranges++;
+
+        if (record) {
+            for (uintptr_t block = start_block; block <= last_block; block++) {
+                set_bit(pass_map, block);
+            }
+        }
+    }
+    return num_ranges;
+}
+
+void sample_end_pass(void)
+{
+    if (tested_map == NULL) {
+        return;
+    }
+    uintptr_t pass_blocks = 0;
+    for (uintptr_t i = 0; i < num_map_words; i++) {
+        pass_blocks += count_bits(pass_map[i]);
+        tested_map[i] |= pass_map[i];
+        pass_map[i] = 0;
+    }
+    uintptr_t num_blocks = collect_pieces(pm_limit_lower, pm_limit_upper);
+    pass_coverage = num_blocks ? (pass_blocks * SAMPLE_FULL) / num_blocks : 0;
+}
+
+int sample_coverage(void)
+{
+    uintptr_t num_blocks = collect_pieces(pm_limit_lower, pm_limit_upper);
+    uintptr_t num_tested = 0;
+    for (int i = 0; i < num_pieces; i++) {
+        for (uintptr_t block = first_block(&pieces[i]); block < end_block(&pieces[i]); block++) {
+            if (test_bit(tested_map, block)) {
+                num_tested++;
+            }
+        }
+    }
+    return num_blocks ? ((uint64_t)num_tested * SAMPLE_FULL) / num_blocks : 0;
+}
+
+void sample_report(void)
+{
+    if (!enable_quick_pass || time_budget > 0 || sample_ratio == SAMPLE_FULL) {
+        return;
+    }
+    if (error_count > 0 || enable_trace || enable_profile) {
+        return;
+    }
+    int coverage = sample_coverage();
+    clear_message_area();
+    display_pinned_message(0, 0, "Quick pass tested %i.%i%% of the memory, %i.%i%% covered so far",
+                           pass_coverage / 10, pass_coverage % 10, coverage / 10, coverage % 10);
+}
@@ -0,0 +1,91 @@
+// SPDX-License-Identifier: GPL-2.0
+#ifndef SAMPLE_H
+#define SAMPLE_H
+/**
+ * \file
+ *
+ * Provides the selection of the memory blocks to be tested when only a
+ * sample of the memory is tested in each pass, either to fit a time budget
+ * or in a quick pass. The blocks tested are recorded, so that no block is
+ * tested again until every block in its window has been tested.
+ *
+ *//*
+ * Copyright (C) 2004-2023 Sam Demeulemeester.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "memsize.h"
+#include "pmem.h"
+
+/**
+ * The sampling ratios are in parts per thousand.
+ */
+#define SAMPLE_FULL         1000
+
+/**
+ * The size of the blocks from which a sample is taken, in pages.
+ */
+#define SAMPLE_BLOCK_SIZE   PAGE_C(2,MB)
+
+/**
+ * The maximum number of sampled ranges in a window. This keeps the number
+ * of segments mapped within the limit.
+ */
+#define MAX_SAMPLE_RANGES   64
+
+/**
+ * The fraction of memory to be tested in each pass, in parts per thousand.
+ */
+extern int sample_ratio;
+
+/**
+ * The ranges of memory (in pages) selected by the last call to
+ * sample_window().
+ */
+extern pm_map_t sample_map[MAX_SAMPLE_RANGES];
+
+/**
+ * Allocates the coverage bitmaps. Must be called after the heap has been
+ * initialised.
+ */
+void sample_init(void);
+
+/**
+ * Forgets which blocks have been tested. Must be called at the start of
+ * each run.
+ */
+void sample_reset(void);
+
+/**
+ * Sets the sampling ratio for the current pass in a quick pass.
+ */
+void sample_start_pass(void);
+
+/**
+ * Selects the blocks to be tested in this pass from the memory in the given
+ * window (in pages), and stores them as a list of ranges in sample_map.
+ * Returns the number of ranges. If record is true, the selected blocks are
+ * recorded as tested at the end of the pass.
+ */
+int sample_window(uintptr_t win_start, uintptr_t win_end, bool record);
+
+/**
+ * Records the blocks tested in the pass just completed.
+ */
+void sample_end_pass(void);
+
+/**
+ * Returns the fraction of the memory that has been tested since the start
+ * of the current round of sampling, in parts per thousand.
+ */
+int sample_coverage(void);
+
+/**
+ * If the pass just completed was a quick pass, displays the fraction of
+ * the memory it tested and the total coverage so far.
+ */
+void sample_report(void);
+
+#endif // SAMPLE_H
@@ -32,6 +32,11 @@ extern uint8_t chunk_index[MAX_CPUS];
   */
 extern int num_active_cpus;
 
+/**
+ * The number of CPU cores enabled for testing.
+ */
+extern int num_enabled_cpus;
+
 /**
  * The current master CPU core.
  */
@@ -111,6 +116,38 @@ extern int test_num;
  */
 extern int window_num;
 
+/**
+ * A flag indicating that testing is restricted to the regions surrounding
+ * previously detected errors.
+ */
+extern bool focus_mode;
+
+/**
+ * A flag indicating that the current virtual memory map only covers selected
+ * parts of the window (the focus, replay or sampled regions), so the first window must
+ * not be extended to cover all selected lower memory.
+ */
+extern bool partial_window;
+
+/**
+ * A flag indicating that the windows to be tested have been counted for the
+ * progress estimates. Cleared when the memory map to be tested changes.
+ */
+extern bool windows_scanned;
+
+/**
+ * The number of pages covered so far by the current test. Windows that are
+ * revisited by a later stage of the test or by another master CPU are only
+ * counted once.
+ */
+extern uint64_t test_pages_covered;
+
+/**
+ * The seed for the random patterns used by the current test. A new seed
+ * is chosen for each test invocation, unless a fixed seed was specified.
+ */
+extern testword_t test_seed;
+
 /**
  * A flag indicating that testing should be restarted due to a configuration
  * change.
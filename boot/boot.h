@@ -85,6 +85,8 @@ extern uint32_t	ap_startup_addr;
 
 extern uint8_t	ap_trampoline_end[];
 
+extern uint8_t	_erodata[];
+
 extern uint8_t	_stacks[];
 
 extern uint8_t	_end[];
@@ -0,0 +1,2 @@
+#define MT_VERSION "7.00"
+#define GIT_HASH "41549b6"
@@ -37,9 +37,17 @@
 #define CPEPSignature   ('C' | ('P' << 8) | ('E' << 16) | ('P' << 24)) // Corrected Platform Error Polling Table
 #define HESTSignature   ('H' | ('E' << 8) | ('S' << 16) | ('T' << 24)) // Hardware Error Source Table
 
+#define DSDTSignature   ('D' | ('S' << 8) | ('D' << 16) | ('T' << 24)) // Differentiated System Description Table
+
 #define SLITSignature   ('S' | ('L' << 8) | ('I' << 16) | ('T' << 24)) // System Locality Information Table (NUMA)
 #define SRATSignature   ('S' | ('R' << 8) | ('A' << 16) | ('T' << 24)) // System Resource Affinity Table (NUMA)
 
+// AML opcodes
+
+#define AML_NAME_OP         0x08
+#define AML_BYTE_PREFIX     0x0a
+#define AML_PACKAGE_OP      0x12
+
 //------------------------------------------------------------------------------
 // Types
 //------------------------------------------------------------------------------
@@ -89,7 +97,7 @@ static const efi_guid_t EFI_ACPI_2_RDSP_GUID = { 0x8868e871, 0xe4f1, 0x11d3, {0x
 
 const char *rsdp_source = "";
 
-acpi_t acpi_config = {0, 0, 0, 0, 0, 0, 0, false};
+acpi_t acpi_config = {0, 0, 0, 0, 0, 0, 0, 0, 0, false, 0, 0, 0, 0};
 
 //------------------------------------------------------------------------------
 // Private Functions
@@ -267,6 +275,50 @@ static uintptr_t find_acpi_table(uint32_t table_signature)
     return 0;
 }
 
+static uint8_t parse_aml_integer(const uint8_t **aml)
+{
+    // A small integer is either a ZeroOp/OneOp or a byte constant.
+    const uint8_t *p = *aml;
+    if (*p == AML_BYTE_PREFIX) {
+        p++;
+    }
+    uint8_t value = *p++;
+    *aml = p;
+    return value;
+}
+
+static bool parse_s5(uintptr_t dsdt_addr)
+{
+    rsdt_header_t *dsdt = (rsdt_header_t *)map_region(dsdt_addr, sizeof(rsdt_header_t), true);
+    if (dsdt == NULL || *(uint32_t *)dsdt != DSDTSignature) return false;
+
+    uint32_t length = dsdt->length;
+    dsdt = (rsdt_header_t *)map_region(dsdt_addr, length, true);
+    if (dsdt == NULL || acpi_checksum(dsdt, length) != 0) {
+        return false;
+    }
+
+    // Rather than interpret the AML, look for the usual encoding of
+    // Name (_S5, Package () { SLP_TYPa, SLP_TYPb, ... })
+    const uint8_t *aml = (const uint8_t *)dsdt + sizeof(rsdt_header_t);
+    const uint8_t *aml_end = (const uint8_t *)dsdt + length - 16;
+    for (; aml < aml_end; aml++) {
+        if (memcmp(aml, "_S5_", 4) != 0 || aml[4] != AML_PACKAGE_OP) {
+            continue;
+        }
+        if (aml[-1] != AML_NAME_OP && (aml[-1] != '\\' || aml[-2] != AML_NAME_OP)) {
+            continue;
+        }
+        const uint8_t *p = aml + 5;
+        p += ((*p & 0xc0) >> 6) + 1;    // skip the package length
+        p++;                            // skip the number of elements
+        acpi_config.slp_typ_a = parse_aml_integer(&p);
+        acpi_config.slp_typ_b = parse_aml_integer(&p);
+        return true;
+    }
+    return false;
+}
+
 static bool parse_fadt(uintptr_t fadt_addr)
 {
     // FADT is a very big & complex table and we only need a few data.
@@ -306,6 +358,45 @@ static bool parse_fadt(uintptr_t fadt_addr)
     }
 #endif
 
+    // Get the PM1 control registers and the sleep type needed for soft-off
+    uintptr_t dsdt_addr = *(uint32_t *)(fadt_addr+FADT_DSDT_OFFSET);
+#ifdef __x86_64__
+    if (fadt->length >= FADT_X_DSDT_OFFSET + sizeof(uint64_t)) {
+        uint64_t *x_dsdt = (uint64_t *)map_region(fadt_addr+FADT_X_DSDT_OFFSET, sizeof(uint64_t), true);
+        if (x_dsdt != NULL && *x_dsdt != 0) {
+            dsdt_addr = *x_dsdt;
+        }
+    }
+#endif
+    if (dsdt_addr != 0 && parse_s5(dsdt_addr)) {
+        acpi_config.pm1a_cnt = *(uint32_t *)(fadt_addr+FADT_PM1A_CNT_BLK_OFFSET);
+        acpi_config.pm1b_cnt = *(uint32_t *)(fadt_addr+FADT_PM1B_CNT_BLK_OFFSET);
+    }
+
+    return true;
+}
+
+static bool parse_hpet(uintptr_t hpet_addr)
+{
+    rsdt_header_t *hpet = (rsdt_header_t *)map_region(hpet_addr, sizeof(rsdt_header_t), true);
+    if (hpet == NULL) return false;
+
+    hpet = (rsdt_header_t *)map_region(hpet_addr, hpet->length, true);
+    if (hpet == NULL) return false;
+
+    // Validate HPET
+    if (hpet->length < HPET_BASE_ADDR_OFFSET + sizeof(acpi_gen_addr_struct) || acpi_checksum(hpet, hpet->length) != 0) {
+        return false;
+    }
+
+    // The event timer block must be memory mapped and within our address range.
+    acpi_gen_addr_struct *base = (acpi_gen_addr_struct *)((uint8_t *)hpet + HPET_BASE_ADDR_OFFSET);
+    if (base->address_space != 0 || base->address == 0 || (uintptr_t)base->address != base->address) {
+        return false;
+    }
+
+    acpi_config.hpet_base = base->address;
+
     return true;
 }
 
@@ -341,4 +432,10 @@ void acpi_init(void)
     }
 
     acpi_config.hpet_addr = find_acpi_table(HPETSignature);
+
+    if (acpi_config.hpet_addr) {
+        parse_hpet(acpi_config.hpet_addr);
+    }
+
+    acpi_config.srat_addr = find_acpi_table(SRATSignature);
 }
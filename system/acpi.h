@@ -14,10 +14,16 @@
 #include <stdbool.h>
 #include <stdint.h>
 
+#define FADT_DSDT_OFFSET            40
+#define FADT_PM1A_CNT_BLK_OFFSET    64
+#define FADT_PM1B_CNT_BLK_OFFSET    68
 #define FADT_PM_TMR_BLK_OFFSET      76
 #define FADT_MINOR_REV_OFFSET       131
+#define FADT_X_DSDT_OFFSET          140
 #define FADT_X_PM_TMR_BLK_OFFSET    208
 
+#define HPET_BASE_ADDR_OFFSET       40
+
 /**
  * A struct containing various ACPI-related infos for later uses.
  */
@@ -29,8 +35,14 @@ typedef struct __attribute__ ((packed)) {
     uintptr_t   madt_addr;
     uintptr_t   fadt_addr;
     uintptr_t   hpet_addr;
+    uintptr_t   hpet_base;
+    uintptr_t   srat_addr;
     uintptr_t   pm_addr;
     bool        pm_is_io;
+    uint16_t    pm1a_cnt;       // zero if the soft-off sleep type was not found
+    uint16_t    pm1b_cnt;
+    uint8_t     slp_typ_a;
+    uint8_t     slp_typ_b;
 } acpi_t;
 
 /**
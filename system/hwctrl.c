@@ -8,18 +8,32 @@
 // Released under version 2 of the Gnu Public License.
 // By Chris Brady
 
+#include <stdbool.h>
+#include <stdint.h>
+
 #include "stddef.h"
 
 #include "boot.h"
 #include "bootparams.h"
 #include "efi.h"
 
+#include "acpi.h"
+
 #include "io.h"
 
 #include "unistd.h"
 
 #include "hwctrl.h"
 
+//------------------------------------------------------------------------------
+// Constants
+//------------------------------------------------------------------------------
+
+#define PM1_CNT_SLP_TYP_SHIFT   10
+#define PM1_CNT_SLP_EN          (1 << 13)
+
+#define POST_CODE_PORT          0x80
+
 //------------------------------------------------------------------------------
 // Private Variables
 //------------------------------------------------------------------------------
@@ -77,6 +91,43 @@ void reboot(void)
     }
 }
 
+void poweroff(void)
+{
+    // If we have UEFI, use the EFI reset service
+    if (efi_rs_table != NULL) {
+        efi_rs_table->reset_system(EFI_RESET_SHUTDOWN, 0, 0);
+        usleep(1000000);
+    }
+
+    // Otherwise enter the ACPI soft-off (S5) sleep state
+    if (acpi_config.pm1a_cnt != 0) {
+        uint16_t pm1a = inw(acpi_config.pm1a_cnt);
+        pm1a &= ~(7 << PM1_CNT_SLP_TYP_SHIFT);
+        outw(pm1a | acpi_config.slp_typ_a << PM1_CNT_SLP_TYP_SHIFT | PM1_CNT_SLP_EN, acpi_config.pm1a_cnt);
+        if (acpi_config.pm1b_cnt != 0) {
+            uint16_t pm1b = inw(acpi_config.pm1b_cnt);
+            pm1b &= ~(7 << PM1_CNT_SLP_TYP_SHIFT);
+            outw(pm1b | acpi_config.slp_typ_b << PM1_CNT_SLP_TYP_SHIFT | PM1_CNT_SLP_EN, acpi_config.pm1b_cnt);
+        }
+        usleep(1000000);
+    }
+
+    // Still here? Just stop.
+    halt();
+}
+
+void halt(void)
+{
+    while (true) {
+        __asm__ __volatile__ ("cli; hlt");
+    }
+}
+
+void post_code(uint8_t code)
+{
+    outb(code, POST_CODE_PORT);
+}
+
 void floppy_off()
 {
     // Stop the floppy motor.
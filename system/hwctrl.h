@@ -10,6 +10,8 @@
  * Copyright (C) 2020-2022 Martin Whitaker.
  */
 
+#include <stdint.h>
+
 /**
  * Initialises the hardware control interface.
  */
@@ -20,6 +22,23 @@ void hwctrl_init(void);
  */
 void reboot(void);
 
+/**
+ * Turns the machine off, using the EFI reset service if available or else
+ * the ACPI soft-off state. If neither works, halts the CPU.
+ */
+void poweroff(void);
+
+/**
+ * Stops the calling CPU. Does not return.
+ */
+void halt(void);
+
+/**
+ * Writes a code to the POST diagnostic port, where it can be seen on a
+ * POST code display or captured by a BMC.
+ */
+void post_code(uint8_t code);
+
 /**
  * Turns off the floppy motor.
  */
@@ -0,0 +1,66 @@
+// SPDX-License-Identifier: GPL-2.0
+// Copyright (C) 2004-2023 Sam Demeulemeester
+//
+// ------------------------
+//
+// DRAM traffic counters for AMD Zen CPUs before Zen 4 (Family 17h and 19h)
+//
+// The Data Fabric has four performance counters per package, each with a
+// control and a count MSR. One counter is programmed per DRAM channel to
+// count the 64-byte requests with data handled by that channel's controller
+// (event 0x07 for the first controller, plus 0x40 for each further one, with
+// unit mask 0x38), which covers both reads and writes. The counters are 48
+// bits wide and free-running once enabled; only the low 32 bits are used, as
+// callers work with the difference between successive readings (modulo
+// 2^32). Zen 4 moved these events to separate UMC counters, which are not
+// supported.
+//
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "cpuid.h"
+#include "memctrl.h"
+#include "msr.h"
+
+#include "imc.h"
+
+#define MSR_AMD64_DF_PERF_CTL0      0xc0010240
+#define MSR_AMD64_DF_PERF_CTR0      0xc0010241
+
+#define DF_PERF_CTL_ENABLE          (1 << 22)
+#define DF_EVENT_DRAM_CHANNEL(n)    (0x07 + 0x40 * (n))
+#define DF_UMASK_DRAM_DATA_REQ      0x38
+
+static int num_channels = 0;
+
+void amd_traffic_init(int channel_mask)
+{
+    num_channels = 0;
+
+    // CPUID Fn8000_0001 ECX bit 24 reports the Data Fabric counters.
+    uint32_t reg[4];
+    cpuid(0x80000001, 0, &reg[0], &reg[1], &reg[2], &reg[3]);
+    if (!(reg[2] & (1 << 24))) {
+        return;
+    }
+
+    for (int ch = 0; ch < IMC_MAX_CHANNELS; ch++) {
+        if (!(channel_mask & (1 << ch))) {
+            continue;
+        }
+        uint32_t ctl = DF_EVENT_DRAM_CHANNEL(ch) | (DF_UMASK_DRAM_DATA_REQ << 8) | DF_PERF_CTL_ENABLE;
+        wrmsr(MSR_AMD64_DF_PERF_CTL0 + 2 * num_channels, ctl, 0);
+        num_channels++;
+    }
+}
+
+int amd_traffic_read(uint32_t lines[IMC_MAX_CHANNELS])
+{
+    for (int i = 0; i < num_channels; i++) {
+        uint32_t lo, hi;
+        rdmsr(MSR_AMD64_DF_PERF_CTR0 + 2 * i, lo, hi);
+        lines[i] = lo;
+    }
+    return num_channels;
+}
@@ -35,6 +35,11 @@ void get_imc_config_amd_zen(void)
     // Populate IMC width
     imc.width = (reg_cha && reg_chb) ? 128 : 64;
 
+    // Before Zen 4, the Data Fabric counts the DRAM traffic of each channel.
+    if (imc.family != IMC_K19_RPL) {
+        amd_traffic_init((reg_cha ? 1 : 0) | (reg_chb ? 2 : 0));
+    }
+
     // Get DRAM Frequency
     smn_reg = amd_smn_read(AMD_SMN_UMC_DRAM_CONFIG + offset);
     if (imc.family >= IMC_K19_RBT) {
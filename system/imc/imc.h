@@ -21,4 +21,17 @@ void get_imc_config_intel_icl(void);
 /* Memory configuration Detection for Intel Alder Lake */
 void get_imc_config_intel_adl(void);
 
+/* Physical address decoding for Intel client IMCs (SNB to KBL) */
+void intel_decode_init_snb(uintptr_t mchbar_addr);
+void intel_decode_init_skl(uintptr_t mchbar_addr);
+bool intel_decode_addr(uint64_t addr, dram_addr_t *dram_addr);
+
+/* DRAM traffic counters for Intel client IMCs (SNB to KBL) */
+void intel_traffic_init(uintptr_t mchbar_addr);
+int intel_traffic_read(uint32_t lines[IMC_MAX_CHANNELS]);
+
+/* DRAM traffic counters for AMD Zen CPUs before Zen 4 */
+void amd_traffic_init(int channel_mask);
+int amd_traffic_read(uint32_t lines[IMC_MAX_CHANNELS]);
+
 #endif /* _IMC_H_ */
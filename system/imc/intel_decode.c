@@ -0,0 +1,265 @@
+// SPDX-License-Identifier: GPL-2.0
+// Copyright (C) 2004-2023 Sam Demeulemeester
+//
+// ------------------------
+//
+// Physical address decoding for Intel client IMCs (SNB to KBL)
+//
+// The decoder follows the two-level layout used by these memory controllers:
+// the channels are interleaved (on bit 6, optionally hashed) up to twice the
+// size of the smaller channel, after which the remainder of the larger channel
+// is mapped linearly. Within a channel, the larger DIMM (L) occupies the lower
+// addresses.
+//
+// Within a DIMM, the 64-bit words are split into column, bank, rank (if rank
+// interleaving is on) and row, from the least significant bits up. If rank
+// interleaving is off, each rank occupies a contiguous part of the DIMM. In
+// enhanced interleave mode, the bank is XORed with the low bits of the row.
+// The column and bank ordering follows the datasheet description of these
+// modes; any further bank hashing used by the IMC is not modelled, so the
+// bank may differ from the one the IMC actually uses.
+//
+// Later IMCs (ICL, ADL and AMD Zen) use different address maps and are not
+// decoded.
+//
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "memctrl.h"
+#include "pci.h"
+
+#include "imc.h"
+
+#define INTEL_HB_REMAPBASE      0x90
+#define INTEL_HB_REMAPLIMIT     0x98
+#define INTEL_HB_TOLUD          0xBC
+
+#define SNB_MMR_MAD_DIMM_CH0    0x5004
+#define SNB_MMR_MAD_DIMM_CH1    0x5008
+
+#define SKL_MMR_MAD_INTRA_CH0   0x5004
+#define SKL_MMR_MAD_INTRA_CH1   0x5008
+#define SKL_MMR_MAD_DIMM_CH0    0x500C
+#define SKL_MMR_MAD_DIMM_CH1    0x5010
+#define SKL_MMR_CHANNEL_HASH    0x5024
+
+#define REMAP_MASK              0x7FFFF00000ULL
+#define TOLUD_MASK              0xFFF00000
+
+#define SKL_MMR_SCHEDULER_CONF  0x401C
+
+#define FOUR_GB                 0x100000000ULL
+
+#define NUM_COLUMN_BITS         10      // 1024 columns for DDR3 and DDR4 x8/x16 devices
+
+typedef struct {
+    bool        valid;
+    uint64_t    tolud;
+    uint64_t    remap_base;
+    uint64_t    remap_limit;
+    int         ch_l;
+    uint64_t    ch_size[IMC_MAX_CHANNELS];
+    uint64_t    dimm_size[IMC_MAX_CHANNELS][IMC_MAX_DIMMS_PER_CHANNEL];    // [ch][L/S]
+    int         dimm_ranks[IMC_MAX_CHANNELS][IMC_MAX_DIMMS_PER_CHANNEL];   // [ch][L/S]
+    int         dimm_width[IMC_MAX_CHANNELS][IMC_MAX_DIMMS_PER_CHANNEL];   // [ch][L/S], device width in bits
+    int         dimm_l_slot[IMC_MAX_CHANNELS];
+    bool        rank_interleave[IMC_MAX_CHANNELS];
+    bool        enhanced_interleave[IMC_MAX_CHANNELS];
+    bool        ddr4;
+    bool        hash_enabled;
+    uint32_t    hash_mask;
+    int         hash_lsb;
+} intel_layout_t;
+
+static intel_layout_t layout;
+
+static uint32_t mmr_read(uintptr_t mchbar_addr, uint32_t reg)
+{
+    return *(volatile uint32_t *)(mchbar_addr + reg);
+}
+
+static int log2_exact(int value)
+{
+    int bits = 0;
+    while ((1 << bits) < value) {
+        bits++;
+    }
+    return (1 << bits) == value ? bits : -1;
+}
+
+static int parity(uint32_t value)
+{
+    int p = 0;
+    for (; value != 0; value &= value - 1) {
+        p ^= 1;
+    }
+    return p;
+}
+
+static void read_host_bridge_layout(void)
+{
+    layout.tolud        = pci_config_read32(0, 0, 0, INTEL_HB_TOLUD) & TOLUD_MASK;
+
+    layout.remap_base   = pci_config_read32(0, 0, 0, INTEL_HB_REMAPBASE);
+    layout.remap_base  |= (uint64_t)pci_config_read32(0, 0, 0, INTEL_HB_REMAPBASE + 4) << 32;
+    layout.remap_base  &= REMAP_MASK;
+
+    layout.remap_limit  = pci_config_read32(0, 0, 0, INTEL_HB_REMAPLIMIT);
+    layout.remap_limit |= (uint64_t)pci_config_read32(0, 0, 0, INTEL_HB_REMAPLIMIT + 4) << 32;
+    layout.remap_limit &= REMAP_MASK;
+    layout.remap_limit += 0x100000;     // The limit is inclusive, with 1MB granularity.
+}
+
+static bool finish_layout(void)
+{
+    for (int ch = 0; ch < IMC_MAX_CHANNELS; ch++) {
+        layout.ch_size[ch] = layout.dimm_size[ch][0] + layout.dimm_size[ch][1];
+    }
+    if (layout.ch_size[0] == 0 && layout.ch_size[1] == 0) {
+        return false;
+    }
+    layout.ch_l = (layout.ch_size[1] > layout.ch_size[0]) ? 1 : 0;
+
+    read_host_bridge_layout();
+
+    return layout.tolud != 0;
+}
+
+void intel_decode_init_snb(uintptr_t mchbar_addr)
+{
+    layout.valid = false;
+
+    for (int ch = 0; ch < IMC_MAX_CHANNELS; ch++) {
+        uint32_t mad_dimm = mmr_read(mchbar_addr, ch ? SNB_MMR_MAD_DIMM_CH1 : SNB_MMR_MAD_DIMM_CH0);
+
+        // DIMM A is the larger DIMM. Sizes are in units of 256MB.
+        layout.dimm_size[ch][0]       = (uint64_t)(mad_dimm & 0xFF) << 28;
+        layout.dimm_size[ch][1]       = (uint64_t)((mad_dimm >> 8) & 0xFF) << 28;
+        layout.dimm_l_slot[ch]        = (mad_dimm >> 16) & 1;
+        layout.dimm_ranks[ch][0]      = ((mad_dimm >> 17) & 1) + 1;
+        layout.dimm_ranks[ch][1]      = ((mad_dimm >> 18) & 1) + 1;
+        layout.dimm_width[ch][0]      = (mad_dimm >> 19) & 1 ? 16 : 8;
+        layout.dimm_width[ch][1]      = (mad_dimm >> 20) & 1 ? 16 : 8;
+        layout.rank_interleave[ch]    = (mad_dimm >> 21) & 1;
+        layout.enhanced_interleave[ch] = (mad_dimm >> 22) & 1;
+    }
+    layout.ddr4 = false;
+    layout.hash_enabled = false;
+
+    layout.valid = finish_layout();
+}
+
+void intel_decode_init_skl(uintptr_t mchbar_addr)
+{
+    layout.valid = false;
+
+    for (int ch = 0; ch < IMC_MAX_CHANNELS; ch++) {
+        uint32_t mad_intra = mmr_read(mchbar_addr, ch ? SKL_MMR_MAD_INTRA_CH1 : SKL_MMR_MAD_INTRA_CH0);
+        uint32_t mad_dimm  = mmr_read(mchbar_addr, ch ? SKL_MMR_MAD_DIMM_CH1  : SKL_MMR_MAD_DIMM_CH0);
+
+        // Sizes are in units of 1GB.
+        layout.dimm_size[ch][0]       = (uint64_t)(mad_dimm & 0x3F) << 30;
+        layout.dimm_size[ch][1]       = (uint64_t)((mad_dimm >> 16) & 0x3F) << 30;
+        layout.dimm_ranks[ch][0]      = ((mad_dimm >>  9) & 0x3) + 1;
+        layout.dimm_ranks[ch][1]      = ((mad_dimm >> 25) & 0x3) + 1;
+        layout.dimm_width[ch][0]      = 8 << ((mad_dimm >>  7) & 0x3);
+        layout.dimm_width[ch][1]      = 8 << ((mad_dimm >> 23) & 0x3);
+        layout.dimm_l_slot[ch]        = mad_intra & 1;
+        layout.rank_interleave[ch]    = (mad_intra >> 4) & 1;
+        layout.enhanced_interleave[ch] = (mad_intra >> 8) & 1;
+    }
+
+    // The DDR type is only reported by the channels in use.
+    uint32_t offset = layout.dimm_size[0][0] ? 0x0000 : 0x0400;
+    layout.ddr4 = (mmr_read(mchbar_addr, offset + SKL_MMR_SCHEDULER_CONF) & 0x3) == 0;
+
+    uint32_t hash = mmr_read(mchbar_addr, SKL_MMR_CHANNEL_HASH);
+    layout.hash_enabled = (hash >> 28) & 1;
+    layout.hash_mask    = hash & 0x3FFF;
+    layout.hash_lsb     = (hash >> 24) & 0x7;
+
+    layout.valid = finish_layout();
+}
+
+bool intel_decode_addr(uint64_t addr, dram_addr_t *dram_addr)
+{
+    if (!layout.valid) {
+        return false;
+    }
+
+    // Undo the remapping of the memory hidden behind the PCI hole.
+    if (addr >= layout.tolud && addr < FOUR_GB) {
+        return false;
+    }
+    if (layout.remap_limit > layout.remap_base && addr >= layout.remap_base && addr < layout.remap_limit) {
+        addr = addr - layout.remap_base + layout.tolud;
+    }
+
+    uint64_t ch_s_size = layout.ch_size[1 - layout.ch_l];
+
+    int ch;
+    uint64_t ch_addr;
+    if (addr < 2 * ch_s_size) {
+        int sel_bit = 6;
+        if (layout.hash_enabled) {
+            sel_bit += layout.hash_lsb;
+            ch = parity((uint32_t)(addr >> 6) & (layout.hash_mask | (1 << layout.hash_lsb)));
+        } else {
+            ch = (addr >> sel_bit) & 1;
+        }
+        ch_addr = ((addr >> (sel_bit + 1)) << sel_bit) | (addr & ((1ULL << sel_bit) - 1));
+    } else {
+        ch = layout.ch_l;
+        ch_addr = addr - ch_s_size;
+    }
+    if (ch_addr >= layout.ch_size[ch]) {
+        return false;
+    }
+
+    int dimm = 0;
+    if (ch_addr >= layout.dimm_size[ch][0]) {
+        ch_addr -= layout.dimm_size[ch][0];
+        dimm = 1;
+    }
+
+    dram_addr->socket  = 0;
+    dram_addr->channel = ch;
+    dram_addr->dimm    = dimm ? 1 - layout.dimm_l_slot[ch] : layout.dimm_l_slot[ch];
+    dram_addr->rank    = -1;
+    dram_addr->bank    = -1;
+    dram_addr->row     = -1;
+    dram_addr->col     = -1;
+
+    // DDR4 x4 and x8 devices have 16 banks (4 bank groups), all others have 8.
+    int ranks     = layout.dimm_ranks[ch][dimm];
+    int rank_bits = log2_exact(ranks);
+    int bank_bits = (layout.ddr4 && layout.dimm_width[ch][dimm] < 16) ? 4 : 3;
+    uint64_t rank_size = layout.dimm_size[ch][dimm] / ranks;
+
+    uint64_t word;
+    if (ranks == 1) {
+        dram_addr->rank = 0;
+        word = ch_addr >> 3;
+    } else if (!layout.rank_interleave[ch]) {
+        dram_addr->rank = ch_addr / rank_size;
+        word = (ch_addr - dram_addr->rank * rank_size) >> 3;
+    } else if (rank_bits > 0) {
+        word = ch_addr >> 3;
+        uint64_t high = word >> (NUM_COLUMN_BITS + bank_bits);
+        dram_addr->rank = high & (ranks - 1);
+        word = ((high >> rank_bits) << (NUM_COLUMN_BITS + bank_bits)) | (word & ((1ULL << (NUM_COLUMN_BITS + bank_bits)) - 1));
+    } else {
+        // Interleaving over a number of ranks that isn't a power of 2 is not modelled.
+        return true;
+    }
+
+    dram_addr->col  = word & ((1 << NUM_COLUMN_BITS) - 1);
+    dram_addr->bank = (word >> NUM_COLUMN_BITS) & ((1 << bank_bits) - 1);
+    dram_addr->row  = word >> (NUM_COLUMN_BITS + bank_bits);
+    if (layout.enhanced_interleave[ch]) {
+        dram_addr->bank ^= dram_addr->row & ((1 << bank_bits) - 1);
+    }
+
+    return true;
+}
@@ -39,6 +39,10 @@ void get_imc_config_intel_hsw(void)
     }
     mmio_reg &= 0xFFFFC000;
 
+    // Capture the address mapping for error attribution and the DRAM traffic counters
+    intel_decode_init_snb((uintptr_t)mmio_reg);
+    intel_traffic_init((uintptr_t)mmio_reg);
+
     // Get DRAM Ratio
     ptr = (uintptr_t*)((uintptr_t)mmio_reg + HSW_REG_MCH_CFG);
     mch_cfg = *ptr & 0xFFFF;
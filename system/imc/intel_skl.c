@@ -52,6 +52,10 @@ void get_imc_config_intel_skl(void)
 
     uintptr_t mchbar_addr = map_region(mmio_reg, SKL_MMR_WINDOW_RANGE, false);
 
+    // Capture the address mapping for error attribution and the DRAM traffic counters
+    intel_decode_init_skl(mchbar_addr);
+    intel_traffic_init(mchbar_addr);
+
     // Get DRAM Ratio
     ptr = (uintptr_t*)(mchbar_addr + SKL_MMR_DRAM_CLOCK);
     reg0 = *ptr & 0xF;
@@ -39,6 +39,10 @@ void get_imc_config_intel_snb(void)
     }
     mmio_reg &= 0xFFFFC000;
 
+    // Capture the address mapping for error attribution and the DRAM traffic counters
+    intel_decode_init_snb((uintptr_t)mmio_reg);
+    intel_traffic_init((uintptr_t)mmio_reg);
+
     // Get DRAM Ratio
     ptr = (uint32_t*)((uintptr_t)mmio_reg + SNB_REG_MCH_CFG);
     mch_cfg = *ptr & 0xFFFF;
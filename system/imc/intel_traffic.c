@@ -0,0 +1,42 @@
+// SPDX-License-Identifier: GPL-2.0
+// Copyright (C) 2004-2023 Sam Demeulemeester
+//
+// ------------------------
+//
+// DRAM traffic counters for Intel client IMCs (SNB to KBL)
+//
+// These IMCs provide free-running 32-bit counters in MCHBAR of the number of
+// 64-byte cache lines read from and written to DRAM, summed over all the
+// channels; there are no per-channel counts. The counters cannot be reset,
+// so callers work with the difference between successive readings (modulo
+// 2^32), which is unaffected by adding the two together.
+//
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "memctrl.h"
+
+#include "imc.h"
+
+#define INTEL_MMR_DRAM_DATA_READS   0x5050
+#define INTEL_MMR_DRAM_DATA_WRITES  0x5054
+
+static uintptr_t mchbar = 0;
+
+void intel_traffic_init(uintptr_t mchbar_addr)
+{
+    mchbar = mchbar_addr;
+}
+
+int intel_traffic_read(uint32_t lines[IMC_MAX_CHANNELS])
+{
+    if (mchbar == 0) {
+        return 0;
+    }
+
+    lines[0] = *(volatile uint32_t *)(mchbar + INTEL_MMR_DRAM_DATA_READS)
+             + *(volatile uint32_t *)(mchbar + INTEL_MMR_DRAM_DATA_WRITES);
+
+    return 1;
+}
@@ -0,0 +1,328 @@
+// SPDX-License-Identifier: GPL-2.0
+// Copyright (C) 2004-2023 Sam Demeulemeester
+//
+// ------------------------
+//
+// Host-side unit tests for the Intel client IMC address decoder.
+//
+// The decoder is built unchanged. The memory controller registers are read
+// from a fake MCHBAR region, and the host bridge registers are supplied by a
+// stub pci_config_read32().
+//
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "memctrl.h"
+#include "pci.h"
+
+#include "imc.h"
+
+//------------------------------------------------------------------------------
+// Constants
+//------------------------------------------------------------------------------
+
+#define MCHBAR_SIZE         0x8000
+
+#define HB_REMAPBASE        0x90
+#define HB_REMAPLIMIT       0x98
+#define HB_TOLUD            0xBC
+
+#define SNB_MAD_DIMM_CH0    0x5004
+#define SNB_MAD_DIMM_CH1    0x5008
+
+#define SKL_MAD_INTRA_CH0   0x5004
+#define SKL_MAD_INTRA_CH1   0x5008
+#define SKL_MAD_DIMM_CH0    0x500C
+#define SKL_MAD_DIMM_CH1    0x5010
+#define SKL_CHANNEL_HASH    0x5024
+
+#define MB                  0x100000ULL
+#define GB                  0x40000000ULL
+
+//------------------------------------------------------------------------------
+// Types
+//------------------------------------------------------------------------------
+
+typedef struct {
+    uint64_t    addr;
+    bool        decoded;
+    int         channel;
+    int         dimm;
+    int         rank;
+    int         bank;
+    int         row;
+    int         col;
+} decode_case_t;
+
+//------------------------------------------------------------------------------
+// Private Variables
+//------------------------------------------------------------------------------
+
+static uint32_t mchbar[MCHBAR_SIZE / sizeof(uint32_t)];
+
+static uint32_t host_bridge[64];
+
+static int num_failures = 0;
+
+//------------------------------------------------------------------------------
+// Stubs
+//------------------------------------------------------------------------------
+
+uint32_t pci_config_read32(int bus, int dev, int func, int reg)
+{
+    if (bus != 0 || dev != 0 || func != 0 || reg < 0 || reg >= (int)sizeof(host_bridge)) {
+        return 0;
+    }
+    return host_bridge[reg / 4];
+}
+
+//------------------------------------------------------------------------------
+// Private Functions
+//------------------------------------------------------------------------------
+
+static void reset_registers(void)
+{
+    memset(mchbar, 0, sizeof(mchbar));
+    memset(host_bridge, 0, sizeof(host_bridge));
+}
+
+static void set_mmr(uint32_t reg, uint32_t value)
+{
+    mchbar[reg / 4] = value;
+}
+
+static void set_host_bridge(uint64_t tolud, uint64_t remap_base, uint64_t remap_size)
+{
+    host_bridge[HB_TOLUD / 4] = (uint32_t)tolud;
+    if (remap_size > 0) {
+        uint64_t remap_limit = remap_base + remap_size - MB;
+        host_bridge[HB_REMAPBASE  / 4 + 0] = (uint32_t)remap_base;
+        host_bridge[HB_REMAPBASE  / 4 + 1] = (uint32_t)(remap_base >> 32);
+        host_bridge[HB_REMAPLIMIT / 4 + 0] = (uint32_t)remap_limit;
+        host_bridge[HB_REMAPLIMIT / 4 + 1] = (uint32_t)(remap_limit >> 32);
+    }
+}
+
+static uint32_t snb_mad_dimm(int size_a_gb, int size_b_gb, int ranks_a, int ranks_b, bool rank_interleave,
+                             bool enhanced_interleave)
+{
+    return (uint32_t)(size_a_gb * 4)
+         | (uint32_t)(size_b_gb * 4) << 8
+         | (uint32_t)(ranks_a - 1) << 17
+         | (uint32_t)(ranks_b - 1) << 18
+         | (uint32_t)rank_interleave << 21
+         | (uint32_t)enhanced_interleave << 22;
+}
+
+static uint32_t skl_mad_dimm(int size_l_gb, int size_s_gb, int ranks_l, int ranks_s)
+{
+    return (uint32_t)size_l_gb
+         | (uint32_t)(ranks_l - 1) << 9
+         | (uint32_t)size_s_gb << 16
+         | (uint32_t)(ranks_s - 1) << 25;
+}
+
+static void check_cases(const char *name, const decode_case_t cases[], int num_cases)
+{
+    for (int i = 0; i < num_cases; i++) {
+        const decode_case_t *c = &cases[i];
+        dram_addr_t d;
+        memset(&d, 0x55, sizeof(d));
+        bool decoded = intel_decode_addr(c->addr, &d);
+        bool ok = decoded == c->decoded;
+        if (ok && decoded) {
+            ok = d.socket == 0 && d.channel == c->channel && d.dimm == c->dimm && d.rank == c->rank
+              && d.bank == c->bank && d.row == c->row && d.col == c->col;
+        }
+        if (!ok) {
+            printf("FAIL %s: addr 0x%llx\n", name, (unsigned long long)c->addr);
+            printf("  expected %s ch %i dimm %i rank %i bank %i row %i col %i\n", c->decoded ? "decoded" : "undecoded",
+                   c->channel, c->dimm, c->rank, c->bank, c->row, c->col);
+            printf("  got      %s ch %i dimm %i rank %i bank %i row %i col %i\n", decoded ? "decoded" : "undecoded",
+                   d.channel, d.dimm, d.rank, (int)d.bank, (int)d.row, (int)d.col);
+            num_failures++;
+        }
+    }
+}
+
+static int compare_keys(const void *a, const void *b)
+{
+    uint64_t key_a = *(const uint64_t *)a;
+    uint64_t key_b = *(const uint64_t *)b;
+    return (key_a > key_b) - (key_a < key_b);
+}
+
+// Checks that no two cache lines in the given range decode to the same DRAM
+// location.
+static void check_unique(const char *name, uint64_t start, uint64_t size)
+{
+    size_t num_lines = size / 64;
+    uint64_t *keys = malloc(num_lines * sizeof(uint64_t));
+    if (keys == NULL) {
+        printf("FAIL %s: out of memory\n", name);
+        num_failures++;
+        return;
+    }
+    for (size_t i = 0; i < num_lines; i++) {
+        dram_addr_t d;
+        if (!intel_decode_addr(start + i * 64, &d) || d.rank < 0 || d.bank < 0 || d.row < 0 || d.col < 0) {
+            printf("FAIL %s: addr 0x%llx not fully decoded\n", name, (unsigned long long)(start + i * 64));
+            num_failures++;
+            free(keys);
+            return;
+        }
+        keys[i] = (uint64_t)d.channel << 62 | (uint64_t)d.dimm << 61 | (uint64_t)d.rank << 58
+                | (uint64_t)d.bank << 53 | (uint64_t)d.row << 16 | (uint64_t)d.col;
+    }
+    qsort(keys, num_lines, sizeof(uint64_t), compare_keys);
+    for (size_t i = 1; i < num_lines; i++) {
+        if (keys[i] == keys[i - 1]) {
+            printf("FAIL %s: two cache lines decode to the same location\n", name);
+            num_failures++;
+            break;
+        }
+    }
+    free(keys);
+}
+
+//------------------------------------------------------------------------------
+// Test Cases
+//------------------------------------------------------------------------------
+
+// Two 4GB dual-rank DIMMs, one per channel, 3GB below 4GB, the remainder
+// remapped above the top of memory.
+static void setup_snb_symmetric(bool rank_interleave, bool enhanced_interleave)
+{
+    reset_registers();
+    set_mmr(SNB_MAD_DIMM_CH0, snb_mad_dimm(4, 0, 2, 1, rank_interleave, enhanced_interleave));
+    set_mmr(SNB_MAD_DIMM_CH1, snb_mad_dimm(4, 0, 2, 1, rank_interleave, enhanced_interleave));
+    set_host_bridge(3 * GB, 8 * GB, 1 * GB);
+    intel_decode_init_snb((uintptr_t)mchbar);
+}
+
+static void test_snb_symmetric(void)
+{
+    setup_snb_symmetric(false, false);
+    const decode_case_t cases[] = {
+        //  addr            decoded  ch dimm rank bank row     col
+        { 0x0,              true,    0, 0,   0,   0,   0,      0     },
+        { 0x40,             true,    1, 0,   0,   0,   0,      0     },
+        { 0x88,             true,    0, 0,   0,   0,   0,      9     },
+        { 0x2000,           true,    0, 0,   0,   0,   0,      512   },
+        { 0x4000,           true,    0, 0,   0,   1,   0,      0     },
+        { 0x20000,          true,    0, 0,   0,   0,   1,      0     },
+        { 3 * GB,           false,   0, 0,   0,   0,   0,      0     },    // PCI hole
+        { 4 * GB - 64,      false,   0, 0,   0,   0,   0,      0     },    // PCI hole
+        { 5 * GB,           true,    0, 0,   1,   0,   0x2000, 0     },
+        { 8 * GB,           true,    0, 0,   0,   0,   0x6000, 0     },    // remapped to 3GB
+        { 8 * GB + 0x40,    true,    1, 0,   0,   0,   0x6000, 0     },
+        { 9 * GB,           false,   0, 0,   0,   0,   0,      0     },    // beyond the end of memory
+    };
+    check_cases("snb symmetric", cases, sizeof(cases) / sizeof(cases[0]));
+    check_unique("snb symmetric", 0, 64 * MB);
+}
+
+static void test_snb_rank_interleave(void)
+{
+    setup_snb_symmetric(true, false);
+    const decode_case_t cases[] = {
+        //  addr            decoded  ch dimm rank bank row     col
+        { 0x0,              true,    0, 0,   0,   0,   0,      0     },
+        { 0x20000,          true,    0, 0,   1,   0,   0,      0     },
+        { 0x40000,          true,    0, 0,   0,   0,   1,      0     },
+        { 0x64000,          true,    0, 0,   1,   1,   1,      0     },
+        { 5 * GB,           true,    0, 0,   0,   0,   0x5000, 0     },
+    };
+    check_cases("snb rank interleave", cases, sizeof(cases) / sizeof(cases[0]));
+    check_unique("snb rank interleave", 0, 64 * MB);
+}
+
+static void test_snb_enhanced_interleave(void)
+{
+    setup_snb_symmetric(false, true);
+    const decode_case_t cases[] = {
+        //  addr            decoded  ch dimm rank bank row     col
+        { 0x0,              true,    0, 0,   0,   0,   0,      0     },
+        { 0x4000,           true,    0, 0,   0,   1,   0,      0     },
+        { 0x20000,          true,    0, 0,   0,   1,   1,      0     },
+        { 0x24000,          true,    0, 0,   0,   0,   1,      0     },
+        { 0xE0000,          true,    0, 0,   0,   7,   7,      0     },
+        { 0xE4000,          true,    0, 0,   0,   6,   7,      0     },
+    };
+    check_cases("snb enhanced interleave", cases, sizeof(cases) / sizeof(cases[0]));
+    check_unique("snb enhanced interleave", 0, 64 * MB);
+}
+
+// A 4GB single-rank DIMM in slot 1 of channel 0 and a 2GB single-rank DIMM
+// in slot 0 of channel 1. Above 4GB, only channel 0 remains.
+static void test_snb_asymmetric(void)
+{
+    reset_registers();
+    set_mmr(SNB_MAD_DIMM_CH0, snb_mad_dimm(4, 0, 1, 1, false, false) | 1 << 16);
+    set_mmr(SNB_MAD_DIMM_CH1, snb_mad_dimm(2, 0, 1, 1, false, false));
+    set_host_bridge(3 * GB, 6 * GB, 1 * GB);
+    intel_decode_init_snb((uintptr_t)mchbar);
+
+    const decode_case_t cases[] = {
+        //  addr            decoded  ch dimm rank bank row     col
+        { 0x0,              true,    0, 1,   0,   0,   0,      0     },
+        { 0x40,             true,    1, 0,   0,   0,   0,      0     },
+        { 4 * GB,           true,    0, 1,   0,   0,   0x8000, 0     },
+        { 5 * GB + 0x40,    true,    0, 1,   0,   0,   0xC000, 8     },
+        { 6 * GB,           true,    0, 1,   0,   0,   0x6000, 0     },    // remapped to 3GB
+        { 6 * GB + 0x40,    true,    1, 0,   0,   0,   0x6000, 0     },
+    };
+    check_cases("snb asymmetric", cases, sizeof(cases) / sizeof(cases[0]));
+    check_unique("snb asymmetric", 4 * GB, 64 * MB);
+}
+
+// Two 8GB dual-rank DDR4 x8 DIMMs, one per channel, with the channel select
+// hashed with address bit 12.
+static void test_skl_hashed(void)
+{
+    reset_registers();
+    set_mmr(SKL_MAD_DIMM_CH0, skl_mad_dimm(8, 0, 2, 1));
+    set_mmr(SKL_MAD_DIMM_CH1, skl_mad_dimm(8, 0, 2, 1));
+    set_mmr(SKL_CHANNEL_HASH, 1 << 28 | 0x40);
+    set_host_bridge(3 * GB, 16 * GB, 1 * GB);
+    intel_decode_init_skl((uintptr_t)mchbar);
+
+    const decode_case_t cases[] = {
+        //  addr            decoded  ch dimm rank bank row     col
+        { 0x0,              true,    0, 0,   0,   0,   0,      0     },
+        { 0x40,             true,    1, 0,   0,   0,   0,      0     },
+        { 0x1000,           true,    1, 0,   0,   0,   0,      256   },
+        { 0x1040,           true,    0, 0,   0,   0,   0,      256   },
+        { 0x4000,           true,    0, 0,   0,   1,   0,      0     },
+        { 0x3C000,          true,    0, 0,   0,   15,  0,      0     },
+        { 0x40000,          true,    0, 0,   0,   0,   1,      0     },
+        { 8 * GB,           true,    0, 0,   1,   0,   0,      0     },
+        { 16 * GB,          true,    0, 0,   0,   0,   0x3000, 0     },    // remapped to 3GB
+    };
+    check_cases("skl hashed", cases, sizeof(cases) / sizeof(cases[0]));
+    check_unique("skl hashed", 0, 64 * MB);
+}
+
+//------------------------------------------------------------------------------
+// Main
+//------------------------------------------------------------------------------
+
+int main(void)
+{
+    test_snb_symmetric();
+    test_snb_rank_interleave();
+    test_snb_enhanced_interleave();
+    test_snb_asymmetric();
+    test_skl_hashed();
+
+    if (num_failures > 0) {
+        printf("%i failure(s)\n", num_failures);
+        return EXIT_FAILURE;
+    }
+    printf("all decode tests passed\n");
+    return EXIT_SUCCESS;
+}
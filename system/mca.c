@@ -0,0 +1,242 @@
+// SPDX-License-Identifier: GPL-2.0
+// Copyright (C) 2004-2023 Sam Demeulemeester
+//
+// ------------------------
+//
+// Generic Machine Check Architecture poller for memory errors
+//
+// The banks that log memory controller errors are shared by all the CPUs in
+// a package, so only the first CPU of each package to poll reads them. Other
+// banks are never touched, and a bank is only cleared once its error has been
+// reported. Errors already logged when a package is first polled (e.g. by the
+// BIOS or a previous boot) are left in place and not reported, unless the
+// bank logs another error.
+//
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "cpuid.h"
+#include "cpuinfo.h"
+#include "msr.h"
+#include "smp.h"
+#include "tsc.h"
+
+#include "config.h"
+
+#include "mca.h"
+
+//------------------------------------------------------------------------------
+// Constants
+//------------------------------------------------------------------------------
+
+#define MCA_POLL_PERIOD     1000    // milliseconds
+
+#define MCI_STATUS_VAL      (1ULL << 63)
+#define MCI_STATUS_OVER     (1ULL << 62)
+#define MCI_STATUS_UC       (1ULL << 61)
+#define MCI_STATUS_MISCV    (1ULL << 59)
+#define MCI_STATUS_ADDRV    (1ULL << 58)
+
+#define MCACOD_MEM_MASK     0xef80  // Compound code 0000 0000 1MMM CCCC (bit 12 is the filter bit)
+#define MCACOD_MEM_VALUE    0x0080
+
+#define SMCA_HWID_UMC       0x96
+
+#define MAX_MCA_BANKS       64
+#define MAX_PACKAGES        16
+
+//------------------------------------------------------------------------------
+// Private Variables
+//------------------------------------------------------------------------------
+
+static int      num_banks = 0;
+
+static bool     smca = false;
+
+static uint64_t next_poll_time[MAX_CPUS];
+
+static bool     is_poller[MAX_CPUS];
+
+static int      package_poller[MAX_PACKAGES];
+
+static uint64_t stale_status[MAX_PACKAGES][MAX_MCA_BANKS];
+
+static int      cpu_package[MAX_CPUS];
+
+//------------------------------------------------------------------------------
+// Private Functions
+//------------------------------------------------------------------------------
+
+static uint64_t read_msr64(uint32_t msr)
+{
+    uint32_t lo, hi;
+
+    rdmsr(msr, lo, hi);
+    return (uint64_t)hi << 32 | lo;
+}
+
+// Returns the package number of the calling CPU, from its initial APIC ID
+// and the number of APIC IDs reserved for each package.
+static int my_package(void)
+{
+    uint32_t eax, ebx, ecx, edx;
+
+    if (cpuid_info.max_cpuid >= 0xb) {
+        // Find the shift of the highest topology level below the package.
+        int shift = 0;
+        for (uint32_t level = 0; level < 8; level++) {
+            cpuid(0xb, level, &eax, &ebx, &ecx, &edx);
+            int level_type = (ecx >> 8) & 0xff;
+            if (level_type == 0) {
+                break;
+            }
+            shift = eax & 0x1f;
+        }
+        if (shift > 0) {
+            return edx >> shift;
+        }
+    }
+
+    cpuid(0x1, 0, &eax, &ebx, &ecx, &edx);
+    int apic_id = ebx >> 24;
+    if (!cpuid_info.flags.htt) {
+        return apic_id;
+    }
+    int num_ids = (ebx >> 16) & 0xff;
+    int shift = 0;
+    while ((1 << shift) < num_ids) {
+        shift++;
+    }
+    return apic_id >> shift;
+}
+
+// Returns the MSR number of register 'reg' (0 = STATUS, 1 = ADDR, 2 = MISC)
+// of the specified bank. The legacy MSRs only cover the first 32 banks, so
+// the scalable MCA layout is used whenever it is available.
+static uint32_t bank_msr(int bank, int reg)
+{
+    if (smca) {
+        return MSR_AMD64_SMCA_MC0_STATUS + 0x10 * bank + reg;
+    }
+    return MSR_IA32_MC0_STATUS + 4 * bank + reg;
+}
+
+static bool is_memory_error(int bank, uint64_t status)
+{
+    if (smca) {
+        uint64_t ipid = read_msr64(MSR_AMD64_SMCA_MC0_IPID + 0x10 * bank);
+        return ((ipid >> 32) & 0xfff) == SMCA_HWID_UMC;
+    }
+    return (status & MCACOD_MEM_MASK) == MCACOD_MEM_VALUE;
+}
+
+//------------------------------------------------------------------------------
+// Public Functions
+//------------------------------------------------------------------------------
+
+void mca_init(void)
+{
+    uint32_t lo, hi;
+
+    num_banks = 0;
+
+    if (!enable_mch_read || !cpuid_info.flags.msr || !cpuid_info.flags.mca || !cpuid_info.flags.mce) {
+        return;
+    }
+
+    rdmsr(MSR_IA32_MCG_CAP, lo, hi);
+    num_banks = lo & 0xff;
+
+    if (num_banks > MAX_MCA_BANKS) {
+        num_banks = MAX_MCA_BANKS;
+    }
+
+    // Zen and later use the scalable MCA register layout, which also provides
+    // the IPID and syndrome registers.
+    smca = false;
+    if (cpuid_info.vendor_id.str[0] == 'A' && cpuid_info.max_xcpuid >= 0x80000007) {
+        uint32_t eax, ebx, ecx, edx;
+        cpuid(0x80000007, 0, &eax, &ebx, &ecx, &edx);
+        smca = (ebx >> 3) & 1;
+    }
+
+    // Beyond bank 31 the legacy MSRs would overlap the VMX capability MSRs.
+    if (!smca && num_banks > 32) {
+        num_banks = 32;
+    }
+
+    for (int i = 0; i < MAX_CPUS; i++) {
+        next_poll_time[i] = 0;
+        is_poller[i] = false;
+    }
+    for (int i = 0; i < MAX_PACKAGES; i++) {
+        package_poller[i] = -1;
+    }
+}
+
+int mca_poll(int my_cpu, mca_error_t errors[MCA_MAX_ERRORS])
+{
+    if (num_banks == 0 || clks_per_msec == 0) {
+        return 0;
+    }
+
+    uint64_t now = get_tsc();
+    if (now < next_poll_time[my_cpu]) {
+        return 0;
+    }
+    bool first_poll = (next_poll_time[my_cpu] == 0);
+    next_poll_time[my_cpu] = now + (uint64_t)MCA_POLL_PERIOD * clks_per_msec;
+
+    if (first_poll) {
+        // The first CPU of each package to get here polls the shared banks.
+        int package = my_package();
+        if (package < MAX_PACKAGES && __sync_bool_compare_and_swap(&package_poller[package], -1, my_cpu)) {
+            is_poller[my_cpu] = true;
+            cpu_package[my_cpu] = package;
+        }
+    }
+    if (!is_poller[my_cpu]) {
+        return 0;
+    }
+    uint64_t *stale = stale_status[cpu_package[my_cpu]];
+
+    int num_errors = 0;
+    for (int bank = 0; bank < num_banks && num_errors < MCA_MAX_ERRORS; bank++) {
+        uint64_t status = read_msr64(bank_msr(bank, 0));
+        if (!(status & MCI_STATUS_VAL) || !is_memory_error(bank, status)) {
+            stale[bank] = 0;
+            continue;
+        }
+        if (first_poll) {
+            stale[bank] = status;
+        }
+        if (status == stale[bank]) {
+            continue;
+        }
+        mca_error_t *err = &errors[num_errors++];
+        err->bank        = bank;
+        err->uncorrected = (status & MCI_STATUS_UC) != 0;
+        err->addr_valid  = (status & MCI_STATUS_ADDRV) != 0;
+        err->status      = status;
+        err->addr        = err->addr_valid ? read_msr64(bank_msr(bank, 1)) : 0;
+        err->misc        = (status & MCI_STATUS_MISCV) ? read_msr64(bank_msr(bank, 2)) : 0;
+        err->syndrome    = smca ? read_msr64(MSR_AMD64_SMCA_MC0_SYND + 0x10 * bank) : err->misc;
+        if (err->addr_valid && (status & MCI_STATUS_MISCV) && !smca) {
+            // Bits 5:0 of MCi_MISC give the least significant valid address bit.
+            int lsb = err->misc & 0x3f;
+            if (lsb < 64) {
+                err->addr &= ~((1ULL << lsb) - 1);
+            }
+        }
+        if (stale[bank] != 0 && (status & MCI_STATUS_OVER)) {
+            // The address may still be that of the error already logged.
+            err->addr_valid = false;
+        }
+        // Writing zero is always permitted and clears the bank for the next error.
+        wrmsr(bank_msr(bank, 0), 0, 0);
+        stale[bank] = 0;
+    }
+
+    return num_errors;
+}
@@ -0,0 +1,51 @@
+// SPDX-License-Identifier: GPL-2.0
+#ifndef MCA_H
+#define MCA_H
+/**
+ * \file
+ *
+ * Provides polling of the Machine Check Architecture banks for memory
+ * errors that are corrected (or signalled) by the hardware and so never
+ * reach the memory tests.
+ *
+ *//*
+ * Copyright (C) 2004-2023 Sam Demeulemeester.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * The maximum number of errors returned by a single call to mca_poll().
+ */
+#define MCA_MAX_ERRORS  4
+
+/**
+ * A memory error logged in an MCA bank.
+ */
+typedef struct {
+    int         bank;
+    bool        uncorrected;
+    bool        addr_valid;
+    uint64_t    status;
+    uint64_t    addr;
+    uint64_t    misc;
+    uint64_t    syndrome;
+} mca_error_t;
+
+/**
+ * Determines whether MCA is supported and how many banks are implemented.
+ */
+void mca_init(void);
+
+/**
+ * If the poll period has elapsed for the calling CPU and it is the CPU that
+ * polls the memory controller banks of its package, reads those banks and
+ * stores any new memory errors found in errors[], clearing the banks they
+ * were read from. Returns the number of memory errors stored. Errors logged
+ * before the first poll (e.g. by the BIOS or a previous boot) are neither
+ * reported nor cleared, and banks that log other errors are left untouched.
+ */
+int mca_poll(int my_cpu, mca_error_t errors[MCA_MAX_ERRORS]);
+
+#endif // MCA_H
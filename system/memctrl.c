@@ -7,17 +7,42 @@
 //
 
 #include <stdbool.h>
+#include <stdint.h>
 
 #include "config.h"
 #include "cpuinfo.h"
 
 #include "memctrl.h"
+#include "smbus.h"
 #include "imc/imc.h"
 
 imc_info_t imc = {"UNDEF", 0, 0, 0, 0, 0, 0, 0, 0};
 
 ecc_info_t ecc_status = {false, ECC_ERR_NONE, 0, 0, 0, 0, 0};
 
+#define CHANNEL_WIDTH   64      // bits, excluding ECC
+
+// ----------------------
+// -- Private function --
+// ----------------------
+
+// Counts the populated channels from the SPD slots of the modules found.
+// By convention, boards wire two SPD addresses to each channel (0x50/0x51
+// to the first, 0x52/0x53 to the second, and so on), and a board with one
+// slot per channel uses the first address of each pair.
+static int spd_channels(void)
+{
+    uint8_t channel_mask = 0;
+    for (int i = 0; i < ram.num_modules; i++) {
+        channel_mask |= 1 << (spd_modules[i].slot_num / 2);
+    }
+    int channels = 0;
+    for (; channel_mask != 0; channel_mask >>= 1) {
+        channels += channel_mask & 1;
+    }
+    return channels;
+}
+
 // ---------------------
 // -- Public function --
 // ---------------------
@@ -64,3 +89,68 @@ void memctrl_init(void)
         imc.freq = 0;
     }
 }
+
+bool memctrl_decode_addr(uint64_t addr, dram_addr_t *dram_addr)
+{
+    if (!enable_mch_read) {
+        return false;
+    }
+
+    switch(imc.family) {
+      case IMC_SNB:
+      case IMC_IVB:
+      case IMC_HSW:
+      case IMC_SKL:
+      case IMC_KBL:
+        return intel_decode_addr(addr, dram_addr);
+      default:
+        return false;
+    }
+}
+
+int memctrl_read_traffic(uint32_t lines[IMC_MAX_CHANNELS])
+{
+    if (!enable_mch_read) {
+        return 0;
+    }
+
+    switch(imc.family) {
+      case IMC_K17:
+      case IMC_K19_VRM:
+      case IMC_K19_RBT:
+        return amd_traffic_read(lines);
+      case IMC_SNB:
+      case IMC_IVB:
+      case IMC_HSW:
+      case IMC_SKL:
+      case IMC_KBL:
+        return intel_traffic_read(lines);
+      default:
+        return 0;
+    }
+}
+
+uint32_t memctrl_peak_bandwidth(uint16_t *width, uint16_t *freq)
+{
+    int spd_width = spd_channels() * CHANNEL_WIDTH;
+
+    // The client controllers report at most IMC_MAX_CHANNELS whole channels.
+    bool imc_width_valid = imc.width > 0 && imc.width % CHANNEL_WIDTH == 0
+                        && imc.width <= IMC_MAX_CHANNELS * CHANNEL_WIDTH;
+
+    if (imc.freq > 0 && imc_width_valid) {
+        // Data can't flow over fewer channels than have modules in them.
+        *width = imc.width > spd_width ? imc.width : spd_width;
+        *freq  = imc.freq;
+    } else if (ram.freq > 0 && spd_width > 0) {
+        *width = spd_width;
+        *freq  = ram.freq;
+    } else {
+        *width = 0;
+        *freq  = 0;
+        return 0;
+    }
+
+    // MT/s x bytes per transfer = bytes/us, so x 1000 for bytes/ms.
+    return (uint32_t)*freq * (*width / 8) * 1000;
+}
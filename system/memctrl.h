@@ -40,6 +40,23 @@ typedef struct __attribute__((packed)) ecc_status {
     uint32_t            err_bank;
 } ecc_info_t;
 
+#define IMC_MAX_CHANNELS            2
+#define IMC_MAX_DIMMS_PER_CHANNEL   2
+
+/**
+ * The location of a physical address within the DRAM. Fields that cannot
+ * be decoded on the current platform are set to -1.
+ */
+typedef struct dram_addr {
+    int8_t      socket;
+    int8_t      channel;
+    int8_t      dimm;
+    int8_t      rank;
+    int32_t     bank;
+    int32_t     row;
+    int32_t     col;
+} dram_addr_t;
+
 /**
  * Current DRAM configuration of the Integrated Memory Controller
  */
@@ -54,4 +71,33 @@ extern ecc_info_t ecc_status;
 
 void memctrl_init(void);
 
+/**
+ * Translates a physical address into its DRAM location. Returns false if
+ * the address cannot be decoded on the current platform.
+ */
+bool memctrl_decode_addr(uint64_t addr, dram_addr_t *dram_addr);
+
+/**
+ * Reads the free-running counters of the number of 64-byte cache lines read
+ * from or written to DRAM. Where the memory controller counts each channel
+ * separately, stores one count per populated channel, in channel order;
+ * otherwise stores the total over all channels in lines[0]. The counters
+ * wrap at 2^32, so only the difference between successive readings is
+ * meaningful. Returns the number of counts stored, which is 0 if there are
+ * no counters on the current platform.
+ */
+int memctrl_read_traffic(uint32_t lines[IMC_MAX_CHANNELS]);
+
+/**
+ * Returns the theoretical peak DRAM bandwidth (in bytes/ms, the unit used
+ * for the measured memory speeds), calculated as the total channel width
+ * times the transfer rate, and stores those in width (bits) and freq (MT/s).
+ * The running configuration reported by the memory controller is used if
+ * known and plausible, but is never narrower than the channels populated
+ * according to the SPD slot numbers (two slots per channel). Otherwise the
+ * slowest SPD speed is used with those channels. Returns 0 if neither is
+ * known.
+ */
+uint32_t memctrl_peak_bandwidth(uint16_t *width, uint16_t *freq);
+
 #endif // MEMCTRL_H
@@ -18,13 +18,33 @@
 #define MSR_IA32_APIC_BASE              0x1b
 #define MSR_IA32_EBL_CR_POWERON         0x2a
 #define MSR_IA32_PLATFORM_INFO          0xce
+#define MSR_IA32_PMC0                   0xc1
+#define MSR_IA32_MPERF                  0xe7
+#define MSR_IA32_APERF                  0xe8
+#define MSR_IA32_MCG_CAP                0x179
+#define MSR_IA32_MCG_STATUS             0x17a
 #define MSR_IA32_MCG_CTL                0x17b
+#define MSR_IA32_PERFEVTSEL0            0x186
 #define MSR_IA32_PERF_STATUS            0x198
 #define MSR_IA32_THERM_STATUS           0x19c
 #define MSR_IA32_TEMPERATURE_TARGET     0x1a2
+#define MSR_IA32_PACKAGE_THERM_STATUS   0x1b1
+#define MSR_IA32_PERF_GLOBAL_CTRL       0x38f
+
+#define MSR_IA32_MC0_CTL                0x400
+#define MSR_IA32_MC0_STATUS             0x401
+#define MSR_IA32_MC0_ADDR               0x402
+#define MSR_IA32_MC0_MISC               0x403
 
 #define MSR_EFER                        0xc0000080
+#define MSR_AMD64_SMCA_MC0_STATUS       0xc0002001
+#define MSR_AMD64_SMCA_MC0_ADDR         0xc0002002
+#define MSR_AMD64_SMCA_MC0_MISC         0xc0002003
+#define MSR_AMD64_SMCA_MC0_IPID         0xc0002005
+#define MSR_AMD64_SMCA_MC0_SYND         0xc0002006
 
+#define MSR_K7_EVNTSEL0                 0xc0010000
+#define MSR_K7_PERFCTR0                 0xc0010004
 #define MSR_K7_HWCR                     0xc0010015
 #define MSR_K7_VID_STATUS               0xc0010042
 
@@ -0,0 +1,197 @@
+// SPDX-License-Identifier: GPL-2.0
+// Copyright (C) 2004-2023 Sam Demeulemeester
+//
+// ------------------------
+//
+// Core performance monitoring counters (Intel architectural PMU and AMD
+// legacy PerfEvtSel/PerfCtr registers)
+//
+// Stall cycles are counted portably as the cycles in which fewer than one
+// instruction retired (retired instructions event, inverted, CMASK = 1).
+// Loads, stores, and DRAM fills use model-specific events, so are only
+// counted on the families that are known to implement them.
+//
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "cpuid.h"
+#include "msr.h"
+
+#include "config.h"
+
+#include "pmu.h"
+
+//------------------------------------------------------------------------------
+// Constants
+//------------------------------------------------------------------------------
+
+#define EVTSEL_USR          (1 << 16)
+#define EVTSEL_OS           (1 << 17)
+#define EVTSEL_EN           (1 << 22)
+#define EVTSEL_INV          (1 << 23)
+#define EVTSEL_CMASK(n)     ((n) << 24)
+
+#define EVENT(event, umask) ((event) | (umask) << 8 | EVTSEL_USR | EVTSEL_OS)
+
+#define INTEL_LLC_MISSES    EVENT(0x2e, 0x41)   // architectural LLC misses
+#define INTEL_ALL_LOADS     EVENT(0xd0, 0x81)   // MEM_{UOPS,INST}_RETIRED.ALL_LOADS (SNB and later)
+#define INTEL_ALL_STORES    EVENT(0xd0, 0x82)   // MEM_{UOPS,INST}_RETIRED.ALL_STORES (SNB and later)
+#define INTEL_STALL_CYCLES  (EVENT(0xc0, 0x00) | EVTSEL_INV | EVTSEL_CMASK(1))
+
+#define ZEN_LS_DISPATCH_LD  EVENT(0x29, 0x01)   // LsDispatch.LdDispatch
+#define ZEN_LS_DISPATCH_ST  EVENT(0x29, 0x02)   // LsDispatch.StoreDispatch
+#define ZEN_DRAM_FILLS      EVENT(0x43, 0x48)   // LsDmndFillsFromSys, local and remote DRAM
+#define AMD_STALL_CYCLES    (EVENT(0xc0, 0x00) | EVTSEL_INV | EVTSEL_CMASK(1))
+
+#define ARCH_EVENT_LLC_MISS (1 << 4)            // CPUID 0xA EBX bit set if unavailable
+
+//------------------------------------------------------------------------------
+// Private Variables
+//------------------------------------------------------------------------------
+
+static uint32_t evtsel_base = 0;
+static uint32_t counter_base = 0;
+
+static int      num_counters = 0;
+
+static uint32_t global_ctrl_mask = 0;
+
+static uint32_t event_select[NUM_PMU_EVENTS];
+
+//------------------------------------------------------------------------------
+// Private Functions
+//------------------------------------------------------------------------------
+
+static bool intel_has_mem_uops_events(void)
+{
+    if (cpuid_info.version.family != 6) {
+        return false;
+    }
+    uint32_t model = cpuid_info.version.extendedModel << 4 | cpuid_info.version.model;
+    switch (model) {
+      case 0x2c:    // Westmere-EP
+      case 0x2e:    // Nehalem-EX
+      case 0x2f:    // Westmere-EX
+      case 0x37:    // Silvermont
+      case 0x4a:
+      case 0x4c:    // Airmont
+      case 0x4d:
+      case 0x5a:
+      case 0x5d:
+        return false;
+      default:
+        return model >= 0x2a;
+    }
+}
+
+static void intel_init(void)
+{
+    if (cpuid_info.max_cpuid < 0xa) {
+        return;
+    }
+    uint32_t eax, ebx, ecx, edx;
+    cpuid(0xa, 0, &eax, &ebx, &ecx, &edx);
+    int version = eax & 0xff;
+    if (version == 0) {
+        return;
+    }
+    num_counters = (eax >> 8) & 0xff;
+    evtsel_base  = MSR_IA32_PERFEVTSEL0;
+    counter_base = MSR_IA32_PMC0;
+
+    if (intel_has_mem_uops_events()) {
+        event_select[PMU_LOADS]  = INTEL_ALL_LOADS;
+        event_select[PMU_STORES] = INTEL_ALL_STORES;
+    }
+    if (!(ebx & ARCH_EVENT_LLC_MISS)) {
+        event_select[PMU_LLC_MISSES] = INTEL_LLC_MISSES;
+    }
+    event_select[PMU_STALL_CYCLES] = INTEL_STALL_CYCLES;
+
+    if (version >= 2) {
+        global_ctrl_mask = (1 << NUM_PMU_EVENTS) - 1;
+    }
+}
+
+static void amd_init(void)
+{
+    if (cpuid_info.version.family != 0xf || cpuid_info.version.extendedFamily == 0) {
+        return;
+    }
+    num_counters = 4;
+    evtsel_base  = MSR_K7_EVNTSEL0;
+    counter_base = MSR_K7_PERFCTR0;
+
+    if (cpuid_info.version.extendedFamily >= 0x8) {
+        event_select[PMU_LOADS]      = ZEN_LS_DISPATCH_LD;
+        event_select[PMU_STORES]     = ZEN_LS_DISPATCH_ST;
+        event_select[PMU_LLC_MISSES] = ZEN_DRAM_FILLS;
+    }
+    event_select[PMU_STALL_CYCLES] = AMD_STALL_CYCLES;
+}
+
+//------------------------------------------------------------------------------
+// Public Functions
+//------------------------------------------------------------------------------
+
+void pmu_init(void)
+{
+    num_counters = 0;
+    global_ctrl_mask = 0;
+    for (int i = 0; i < NUM_PMU_EVENTS; i++) {
+        event_select[i] = 0;
+    }
+
+    if (!enable_mch_read || !cpuid_info.flags.msr) {
+        return;
+    }
+
+    switch (cpuid_info.vendor_id.str[0]) {
+      case 'G':
+        intel_init();
+        break;
+      case 'A':
+        amd_init();
+        break;
+      default:
+        break;
+    }
+    if (num_counters > NUM_PMU_EVENTS) {
+        num_counters = NUM_PMU_EVENTS;
+    }
+}
+
+bool pmu_event_supported(pmu_event_t event)
+{
+    return (int)event < num_counters && event_select[event] != 0;
+}
+
+void pmu_start(void)
+{
+    if (global_ctrl_mask != 0) {
+        // Enable the general-purpose counters globally; each counter is
+        // then controlled by the EN bit in its event select register.
+        wrmsr(MSR_IA32_PERF_GLOBAL_CTRL, global_ctrl_mask, 0);
+    }
+    for (int i = 0; i < num_counters; i++) {
+        wrmsr(evtsel_base + i, 0, 0);
+        wrmsr(counter_base + i, 0, 0);
+        if (event_select[i] != 0) {
+            wrmsr(evtsel_base + i, event_select[i] | EVTSEL_EN, 0);
+        }
+    }
+}
+
+void pmu_stop(uint64_t counts[NUM_PMU_EVENTS])
+{
+    for (int i = 0; i < num_counters; i++) {
+        if (event_select[i] == 0) {
+            continue;
+        }
+        uint32_t lo, hi;
+        wrmsr(evtsel_base + i, event_select[i], 0);
+        rdmsr(counter_base + i, lo, hi);
+        counts[i] += (uint64_t)hi << 32 | lo;
+    }
+}
@@ -0,0 +1,50 @@
+// SPDX-License-Identifier: GPL-2.0
+#ifndef PMU_H
+#define PMU_H
+/**
+ * \file
+ *
+ * Provides access to the CPU core performance monitoring counters.
+ *
+ *//*
+ * Copyright (C) 2004-2023 Sam Demeulemeester.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * The events counted by the performance monitoring counters.
+ */
+typedef enum {
+    PMU_LOADS,              // retired load instructions
+    PMU_STORES,             // retired store instructions
+    PMU_LLC_MISSES,         // cache lines filled from DRAM
+    PMU_STALL_CYCLES,       // core cycles in which no instruction retired
+    NUM_PMU_EVENTS
+} pmu_event_t;
+
+/**
+ * Determines which events can be counted on this CPU. Must be called
+ * before any other PMU function. As a virtual machine may not implement
+ * the counter registers, this should only be called when the user has
+ * asked for the counters to be used.
+ */
+void pmu_init(void);
+
+/**
+ * Returns true if the given event can be counted on this CPU.
+ */
+bool pmu_event_supported(pmu_event_t event);
+
+/**
+ * Programs, clears, and starts the counters of the calling CPU.
+ */
+void pmu_start(void);
+
+/**
+ * Stops the counters of the calling CPU and adds their values to counts[].
+ */
+void pmu_stop(uint64_t counts[NUM_PMU_EVENTS]);
+
+#endif // PMU_H
@@ -12,6 +12,12 @@
 
 #include "screen.h"
 
+//------------------------------------------------------------------------------
+// Constants
+//------------------------------------------------------------------------------
+
+#define MAX_GLYPH_COLOURS   32      // colour pairs with a cached glyph table
+
 //------------------------------------------------------------------------------
 // Private Variables
 //------------------------------------------------------------------------------
@@ -53,6 +59,16 @@ static uintptr_t lfb_stride;
 
 static uint32_t lfb_pallete[16];
 
+typedef struct {
+    uint32_t    run[16][4];     // four pixels for each value of a half font byte
+} glyph_colours_t;
+
+static glyph_colours_t *glyph_colours[256];     // indexed by attribute
+
+static glyph_colours_t glyph_colour_pool[MAX_GLYPH_COLOURS];
+
+static int num_glyph_colours = 0;
+
 static uint8_t current_attr = WHITE | BLUE << 4;
 
 //------------------------------------------------------------------------------
@@ -69,83 +85,86 @@ static void vga_put_char(int row, int col, uint8_t ch, uint8_t attr)
     }
 }
 
-static void lfb8_put_char(int row, int col, uint8_t ch, uint8_t attr)
-{
-    shadow_buffer[row][col].ch   = ch;
-    shadow_buffer[row][col].attr = attr;
+// Each row of a glyph is built from two runs of four pixels, one for each
+// half of the font byte. For each colour pair in use, we keep a table of the
+// 16 possible runs, pre-expanded to the native pixel format. A run of four
+// pixels occupies exactly one 32-bit word per byte per pixel, so a glyph row
+// is written as one 64-bit word per byte per pixel.
 
-    uint8_t fg_colour = attr % 16;
-    uint8_t bg_colour = attr / 16;
-
-    uint8_t *pixel_row = (uint8_t *)lfb_base + row * FONT_HEIGHT * lfb_stride + col * FONT_WIDTH;
-    for (int y = 0; y < FONT_HEIGHT; y++) {
-        uint8_t font_row = font_data[ch][y];
-        for (int x = 0; x < FONT_WIDTH; x++) {
-            pixel_row[x] = font_row & 0x80 ? fg_colour : bg_colour;
-            font_row <<= 1;
+static const glyph_colours_t *get_glyph_colours(uint8_t attr, glyph_colours_t *temp_colours)
+{
+    glyph_colours_t *colours = glyph_colours[attr];
+    if (colours != NULL) {
+        return colours;
+    }
+    // Once a table has been published it is never modified, so other CPUs can
+    // use it without locking. If we run out of tables, build a temporary one.
+    int index = __sync_fetch_and_add(&num_glyph_colours, 1);
+    colours = index < MAX_GLYPH_COLOURS ? &glyph_colour_pool[index] : temp_colours;
+
+    uint32_t fg_colour = lfb_bytes_per_pixel == 1 ? attr % 16 : lfb_pallete[attr % 16];
+    uint32_t bg_colour = lfb_bytes_per_pixel == 1 ? attr / 16 : lfb_pallete[attr / 16];
+    for (int bits = 0; bits < 16; bits++) {
+        uint8_t *pixel = (uint8_t *)colours->run[bits];
+        for (int x = 0; x < 4; x++) {
+            uint32_t colour = bits & (0x8 >> x) ? fg_colour : bg_colour;
+            for (int i = 0; i < lfb_bytes_per_pixel; i++) {
+                *pixel++ = colour & 0xff;
+                colour >>= 8;
+            }
         }
-        pixel_row += lfb_stride;
     }
+    if (index < MAX_GLYPH_COLOURS) {
+        __sync_synchronize();
+        glyph_colours[attr] = colours;
+    }
+    return colours;
 }
 
-static void lfb16_put_char(int row, int col, uint8_t ch, uint8_t attr)
+static void lfb_put_glyph(int row, int col, uint8_t ch, uint8_t attr, int bytes_per_pixel)
 {
     shadow_buffer[row][col].ch   = ch;
     shadow_buffer[row][col].attr = attr;
 
-    uint16_t fg_colour = lfb_pallete[attr % 16];
-    uint16_t bg_colour = lfb_pallete[attr / 16];
+    glyph_colours_t temp_colours;
+    const glyph_colours_t *colours = get_glyph_colours(attr, &temp_colours);
 
-    uint16_t *pixel_row = (uint16_t *)lfb_base + row * FONT_HEIGHT * lfb_stride + col * FONT_WIDTH;
+    uint8_t *pixel_row = (uint8_t *)lfb_base + row * FONT_HEIGHT * lfb_stride + col * FONT_WIDTH * bytes_per_pixel;
     for (int y = 0; y < FONT_HEIGHT; y++) {
         uint8_t font_row = font_data[ch][y];
-        for (int x = 0; x < FONT_WIDTH; x++) {
-            pixel_row[x] = font_row & 0x80 ? fg_colour : bg_colour;
-            font_row <<= 1;
+        const uint32_t *left  = colours->run[font_row >> 4];
+        const uint32_t *right = colours->run[font_row & 0xf];
+        uint32_t words[2 * 4];
+        for (int i = 0; i < bytes_per_pixel; i++) {
+            words[i] = left[i];
+            words[bytes_per_pixel + i] = right[i];
+        }
+        uint64_t *pixels = (uint64_t *)pixel_row;
+        for (int i = 0; i < bytes_per_pixel; i++) {
+            pixels[i] = words[2*i] | (uint64_t)words[2*i+1] << 32;
         }
         pixel_row += lfb_stride;
     }
 }
 
-static void lfb24_put_char(int row, int col, uint8_t ch, uint8_t attr)
+static void lfb8_put_char(int row, int col, uint8_t ch, uint8_t attr)
 {
-    shadow_buffer[row][col].ch   = ch;
-    shadow_buffer[row][col].attr = attr;
+    lfb_put_glyph(row, col, ch, attr, 1);
+}
 
-    uint32_t fg_colour = lfb_pallete[attr % 16];
-    uint32_t bg_colour = lfb_pallete[attr / 16];
+static void lfb16_put_char(int row, int col, uint8_t ch, uint8_t attr)
+{
+    lfb_put_glyph(row, col, ch, attr, 2);
+}
 
-    uint8_t *pixel_row = (uint8_t *)lfb_base + row * FONT_HEIGHT * lfb_stride + col * FONT_WIDTH * 3;
-    for (int y = 0; y < FONT_HEIGHT; y++) {
-        uint8_t font_row = font_data[ch][y];
-        for (int x = 0; x < FONT_WIDTH * 3; x += 3) {
-            uint32_t colour = font_row & 0x80 ? fg_colour : bg_colour;
-            pixel_row[x+0] = colour & 0xff; colour >>= 8;
-            pixel_row[x+1] = colour & 0xff; colour >>= 8;
-            pixel_row[x+2] = colour & 0xff;
-            font_row <<= 1;
-        }
-        pixel_row += lfb_stride;
-    }
+static void lfb24_put_char(int row, int col, uint8_t ch, uint8_t attr)
+{
+    lfb_put_glyph(row, col, ch, attr, 3);
 }
 
 static void lfb32_put_char(int row, int col, uint8_t ch, uint8_t attr)
 {
-    shadow_buffer[row][col].ch   = ch;
-    shadow_buffer[row][col].attr = attr;
-
-    uint32_t fg_colour = lfb_pallete[attr % 16];
-    uint32_t bg_colour = lfb_pallete[attr / 16];
-
-    uint32_t *pixel_row = (uint32_t *)lfb_base + row * FONT_HEIGHT * lfb_stride + col * FONT_WIDTH;
-    for (int y = 0; y < FONT_HEIGHT; y++) {
-        uint8_t font_row = font_data[ch][y];
-        for (int x = 0; x < FONT_WIDTH; x++) {
-            pixel_row[x] = font_row & 0x80 ? fg_colour : bg_colour;
-            font_row <<= 1;
-        }
-        pixel_row += lfb_stride;
-    }
+    lfb_put_glyph(row, col, ch, attr, 4);
 }
 
 static void (*put_char)(int, int, uint8_t, uint8_t) = vga_put_char;
@@ -206,7 +225,7 @@ void screen_init(void)
         if (lfb_height > 8192) lfb_height = 8192;
 
         // The above clipping should guarantee the mapping never fails.
-        lfb_base = map_region(lfb_base, lfb_height * lfb_stride, false);
+        lfb_base = map_region_wc(lfb_base, lfb_height * lfb_stride);
 
         // Blank the whole framebuffer.
         int pixels_per_word = sizeof(uint32_t) / lfb_bytes_per_pixel;
@@ -227,10 +246,6 @@ void screen_init(void)
             lfb_base += (excess_height / 2) * lfb_stride;
         }
 
-        if (lfb_bytes_per_pixel != 3) {
-            lfb_stride /= lfb_bytes_per_pixel;
-        }
-
         // Initialise the pallete.
         uint32_t r_max = (1 << screen_info->red_size  ) - 1;
         uint32_t g_max = (1 << screen_info->green_size) - 1;
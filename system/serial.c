@@ -1,11 +1,28 @@
 // SPDX-License-Identifier: GPL-2.0
 // Copyright (C) 2004-2023 Sam Demeulemeester
+//
+// Output to the serial console is queued in a transmit ring, which is
+// drained into the UART FIFO whenever there is room, so the caller never
+// waits for the UART unless the ring is full. The ring is drained after
+// each write and whenever the serial port is polled for input.
+//
+// The screen contents last sent to the terminal are remembered, so that a
+// redraw only sends the cells that have changed, using the cheapest cursor
+// motion to reach each one.
+//
+// In JSON mode the terminal is not drawn at all, and only the records sent
+// with serial_echo_print reach the serial console.
+//
+// Any CPU may send output or poll for input, so the ring and the terminal
+// state are protected by a lock. A CPU that only wants to drain the ring
+// doesn't wait for the lock, as whoever holds it will drain the ring anyway.
 
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 
 #include "io.h"
+#include "spinlock.h"
 #include "string.h"
 #include "serial.h"
 #include "unistd.h"
@@ -13,8 +30,37 @@
 #include "config.h"
 #include "display.h"
 
+//------------------------------------------------------------------------------
+// Constants
+//------------------------------------------------------------------------------
+
+#define TX_RING_SIZE    16384   // must be a power of 2
+
+#define CELL_INVERSE    0x100
+
+#define MAX_GAP_FILL    4       // resending up to this many cells is cheaper than a cursor move
+
+//------------------------------------------------------------------------------
+// Private Variables
+//------------------------------------------------------------------------------
+
 static struct serial_port console_serial;
 
+static char     tx_ring[TX_RING_SIZE];
+static uint32_t tx_head = 0;
+static uint32_t tx_tail = 0;
+static int      tx_fifo_size = 1;
+
+static spinlock_t tx_lock = false;
+
+// The character and attribute last sent to each terminal cell.
+static uint16_t sent_cell[SCREEN_HEIGHT][SCREEN_WIDTH];
+
+// The terminal cursor position and attribute, or -1 if unknown.
+static int      cursor_row = -1;
+static int      cursor_col = -1;
+static int      cursor_inverse = -1;
+
 //------------------------------------------------------------------------------
 // Private Functions
 //------------------------------------------------------------------------------
@@ -51,46 +97,210 @@ static uint8_t serial_read_reg(struct serial_port *port, uint16_t reg)
     }
 }
 
-static void serial_wait_for_xmit(struct serial_port *port)
+static void serial_drain(struct serial_port *port)
 {
-    uint8_t lsr;
-
-    do {
-        lsr = serial_read_reg(port, UART_LSR);
-    } while ((lsr & BOTH_EMPTY) != BOTH_EMPTY);
+    while (tx_tail != tx_head) {
+        if (!(serial_read_reg(port, UART_LSR) & UART_LSR_THRE)) {
+            return;
+        }
+        // The transmit FIFO is empty, so can take a full FIFO's worth.
+        for (int i = 0; i < tx_fifo_size && tx_tail != tx_head; i++) {
+            serial_write_reg(port, UART_TX, tx_ring[tx_tail++ & (TX_RING_SIZE - 1)]);
+        }
+    }
 }
 
-void serial_echo_print(const char *p)
+static void serial_queue(const char *p)
 {
     struct serial_port *port = &console_serial;
 
-    if (!port->enable) {
-        return;
+    while (*p) {
+        // If the ring is full, there's no choice but to wait for the UART.
+        while (tx_head - tx_tail >= TX_RING_SIZE) {
+            serial_drain(port);
+        }
+        tx_ring[tx_head++ & (TX_RING_SIZE - 1)] = *p++;
     }
+}
 
-    /* Now, do each character */
-    while (*p) {
-        /* Send the character out. */
-        serial_wait_for_xmit(port);
-        serial_write_reg(port, UART_TX, *p++);
+static uint16_t tty_cell(int row, int col)
+{
+    uint16_t cell = shadow_buffer[row][col].ch;
+
+    /* Make sure only VT100 characters are sent. */
+    switch (cell) {
+        case 32 ... 127:
+            break;
+
+        case 0xB3:
+            cell = '|';
+            break;
+
+        case 0xC1:
+        case 0xC2:
+        case 0xC4:
+            cell = '-';
+            break;
+
+        case 0xF8:
+            cell = '*';
+            break;
+
+        default:
+            cell = '?';
+    }
+
+    if ((shadow_buffer[row][col].attr & 0x70) >> 4 != BLUE) {
+        cell |= CELL_INVERSE;
     }
+    return cell;
 }
 
-void tty_goto(int y, int x)
+static void tty_put_cell(uint16_t cell)
 {
-    static char s[3];
+    char s[2];
 
-    serial_echo_print("\x1b[");
-    serial_echo_print(itoa(y + 1, s));
-    serial_echo_print(";");
-    serial_echo_print(itoa(x + 1, s));
-    serial_echo_print("H");
+    int inverse = (cell & CELL_INVERSE) != 0;
+    if (cursor_inverse != inverse) {
+        serial_queue(inverse ? TTY_INVERSE : TTY_NORMAL);
+        cursor_inverse = inverse;
+    }
+    s[0] = cell & 0xFF;
+    s[1] = '\0';
+    serial_queue(s);
+
+    // Don't rely on the terminal's behaviour at the right margin.
+    if (++cursor_col >= SCREEN_WIDTH) {
+        cursor_row = -1;
+        cursor_col = -1;
+    }
+}
+
+static bool tty_can_fill(int row, int start_col, int end_col)
+{
+    for (int col = start_col; col < end_col; col++) {
+        uint16_t cell = sent_cell[row][col];
+        if (((cell & CELL_INVERSE) != 0) != cursor_inverse) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void tty_goto(int y, int x)
+{
+    char s[3];
+
+    if (y == cursor_row && x == cursor_col) {
+        return;
+    }
+
+    if (y == cursor_row && x > cursor_col) {
+        // Moving forward along the same row: resending a few unchanged cells
+        // is shorter than a cursor motion sequence.
+        if (x - cursor_col <= MAX_GAP_FILL && tty_can_fill(y, cursor_col, x)) {
+            while (cursor_col < x) {
+                tty_put_cell(sent_cell[y][cursor_col]);
+            }
+            return;
+        }
+        serial_queue("\x1b[");
+        serial_queue(itoa(x - cursor_col, s));
+        serial_queue("C");
+    } else {
+        // Always use absolute positioning to change row instead of relying on CR-LF to avoid
+        // issues when a CR-LF is lost (especially with Industrial RS232/Ethernet converters).
+        serial_queue("\x1b[");
+        serial_queue(itoa(y + 1, s));
+        serial_queue(";");
+        serial_queue(itoa(x + 1, s));
+        serial_queue("H");
+    }
+    cursor_row = y;
+    cursor_col = x;
 }
 
 //------------------------------------------------------------------------------
 // Public Functions
 //------------------------------------------------------------------------------
 
+void serial_echo_print(const char *p)
+{
+    if (!console_serial.enable) {
+        return;
+    }
+
+    spin_lock(&tx_lock);
+
+    serial_queue(p);
+
+    // The caller may have moved the cursor or changed the attribute.
+    cursor_row = -1;
+    cursor_col = -1;
+    cursor_inverse = -1;
+
+    serial_drain(&console_serial);
+
+    spin_unlock(&tx_lock);
+}
+
+void tty_clear_screen(void)
+{
+    if (!console_serial.enable || enable_tty_json) {
+        return;
+    }
+
+    spin_lock(&tx_lock);
+
+    serial_queue(TTY_NORMAL TTY_CLEAR_SCREEN);
+
+    for (int row = 0; row < SCREEN_HEIGHT; row++) {
+        for (int col = 0; col < SCREEN_WIDTH; col++) {
+            sent_cell[row][col] = ' ';
+        }
+    }
+    cursor_row = -1;
+    cursor_col = -1;
+    cursor_inverse = false;
+
+    serial_drain(&console_serial);
+
+    spin_unlock(&tx_lock);
+}
+
+void tty_drain(void)
+{
+    if (!console_serial.enable) {
+        return;
+    }
+
+    if (!__sync_bool_compare_and_swap(&tx_lock, false, true)) {
+        return;
+    }
+
+    serial_drain(&console_serial);
+
+    spin_unlock(&tx_lock);
+}
+
+void tty_flush(void)
+{
+    if (!console_serial.enable) {
+        return;
+    }
+
+    spin_lock(&tx_lock);
+
+    while (tx_tail != tx_head) {
+        serial_drain(&console_serial);
+    }
+    while ((serial_read_reg(&console_serial, UART_LSR) & BOTH_EMPTY) != BOTH_EMPTY) {
+        // wait for the last character to leave the UART
+    }
+
+    spin_unlock(&tx_lock);
+}
+
 void tty_init(void)
 {
     if (!enable_tty) {
@@ -142,18 +352,31 @@ void tty_init(void)
     if (console_serial.is_mmio) {
         serial_write_reg(&console_serial, UART_FCR, 0x00);
         serial_write_reg(&console_serial, UART_FCR, (0xFF) & (UART_FCR_ENA | UART_FCR_THR));
+    } else {
+        serial_write_reg(&console_serial, UART_FCR, UART_FCR_ENA | UART_FCR_CLEAR_RCVR | UART_FCR_CLEAR_XMIT);
+    }
+
+    /* Only a 16550A (or later) has a usable transmit FIFO */
+    if ((serial_read_reg(&console_serial, UART_IIR) & UART_IIR_FIFO_MASK) == UART_IIR_FIFO_ENABLED) {
+        tx_fifo_size = UART_FIFO_SIZE;
+    } else {
+        tx_fifo_size = 1;
+        if (!console_serial.is_mmio) {
+            serial_write_reg(&console_serial, UART_FCR, 0x00);
+        }
     }
 
-    tty_clear_screen();
-    tty_disable_cursor();
+    if (!enable_tty_json) {
+        tty_clear_screen();
+        tty_disable_cursor();
+    }
 }
 
 void tty_send_region(int start_row, int start_col, int end_row, int end_col)
 {
-    char p[SCREEN_WIDTH+1];
-    uint8_t ch;
-    int pos = 0;
-    int cur_inverse = -1, inverse = false;
+    if (!console_serial.enable || enable_tty_json) {
+        return;
+    }
 
     if (start_col > (SCREEN_WIDTH - 1) || end_col > (SCREEN_WIDTH - 1)) {
         return;
@@ -163,72 +386,30 @@ void tty_send_region(int start_row, int start_col, int end_row, int end_col)
         return;
     }
 
-    for (int row = start_row; row <= end_row; row++) {
-
-        // Always use absolute positioning instead of relying on CR-LF to avoid issues
-        // when a CR-LF is lost (especially with Industrial RS232/Ethernet converters).
-        tty_goto(row, start_col);
+    spin_lock(&tx_lock);
 
-        // Copy Shadow buffer to TTY buffer
-        pos = 0;
+    // Only send the cells that differ from those last sent.
+    for (int row = start_row; row <= end_row; row++) {
         for (int col = start_col; col <= end_col; col++) {
-
-            inverse = ((shadow_buffer[row][col].attr & 0x70) >> 4 != BLUE);
-
-            if (cur_inverse != inverse) {
-
-                if (pos) {
-                  p[pos] = '\0';
-                  serial_echo_print(p);
-                  pos = 0;
-                }
-
-                if (inverse) {
-                    tty_inverse();
-                } else {
-                    tty_normal();
-                }
-
-                cur_inverse = inverse;
+            uint16_t cell = tty_cell(row, col);
+            if (cell != sent_cell[row][col]) {
+                tty_goto(row, col);
+                tty_put_cell(cell);
+                sent_cell[row][col] = cell;
             }
-
-            /* Make sure only VT100 characters are sent. */
-            ch = shadow_buffer[row][col].ch;
-
-            switch (ch) {
-                case 32 ... 127:
-                    break;
-
-                case 0xB3:
-                    ch = '|';
-                    break;
-
-                case 0xC1:
-                case 0xC2:
-                case 0xC4:
-                    ch = '-';
-                    break;
-
-                case 0xF8:
-                    ch = '*';
-                    break;
-
-                default:
-                    ch = '?';
-            }
-
-            p[pos++] = ch;
-        }
-
-        if (pos) {
-            p[pos] = '\0';
-            serial_echo_print(p);
         }
     }
+
+    serial_drain(&console_serial);
+
+    spin_unlock(&tx_lock);
 }
 
 char tty_get_key(void)
 {
+    // This is polled regularly, so is a good time to send any queued output.
+    tty_drain();
+
     int uart_status = serial_read_reg(&console_serial, UART_LSR);
 
     if (uart_status & UART_LSR_DR) {
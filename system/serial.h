@@ -97,6 +97,8 @@ struct serial_port {
  */
 #define UART_IIR_NO_INT 0x01    /* No interrupts pending */
 #define UART_IIR_ID     0x06    /* Mask for the interrupt ID */
+#define UART_IIR_FIFO_MASK    0xC0  /* Mask for the FIFO status */
+#define UART_IIR_FIFO_ENABLED 0xC0  /* Working FIFO (16550A or later) */
 
 #define UART_IIR_MSI    0x00    /* Modem status interrupt */
 #define UART_IIR_THRI   0x02    /* Transmitter holding register empty */
@@ -107,8 +109,12 @@ struct serial_port {
  * Definitions for the FIFO Control Register
  */
 #define UART_FCR_ENA   0x01     /* FIFO Enable */
+#define UART_FCR_CLEAR_RCVR 0x02    /* Clear the RCVR FIFO */
+#define UART_FCR_CLEAR_XMIT 0x04    /* Clear the XMIT FIFO */
 #define UART_FCR_THR   0x20     /* FIFO Threshold */
 
+#define UART_FIFO_SIZE  16      /* 16550A transmit FIFO depth */
+
 /*
  * Definitions for the Interrupt Enable Register
  */
@@ -151,7 +157,10 @@ struct serial_port {
 #define BOTH_EMPTY (UART_LSR_TEMT | UART_LSR_THRE)
 
 #define tty_full_redraw() \
-    tty_send_region(0, 0, 24, 79);
+    do { \
+        tty_clear_screen(); \
+        tty_send_region(0, 0, 24, 79); \
+    } while (0)
 
 #define tty_partial_redraw() \
     tty_send_region(1, 34, 5, 79); \
@@ -170,13 +179,35 @@ struct serial_port {
 #define tty_disable_cursor() \
     serial_echo_print(TTY_DISABLE_CURSOR);
 
-#define tty_clear_screen() \
-    serial_echo_print(TTY_CLEAR_SCREEN);
+/**
+ * Queues a string to be sent to the serial console and sends as much of
+ * the queue as the UART can accept without waiting.
+ */
+void serial_echo_print(const char *p);
+
+/**
+ * Clears the terminal screen. Does nothing in JSON mode.
+ */
+void tty_clear_screen(void);
+
+/**
+ * Sends as much of the queued output as the UART can accept without waiting.
+ */
+void tty_drain(void);
+
+/**
+ * Waits until all the queued output has been sent.
+ */
+void tty_flush(void);
 
 void tty_init(void);
 
 void tty_print(int y, int x, const char *p);
 
+/**
+ * Sends the cells in the given region of the screen that have changed since
+ * they were last sent. Does nothing in JSON mode.
+ */
 void tty_send_region(int start_row, int start_col, int end_row, int end_col);
 
 char tty_get_key(void);
@@ -2,6 +2,8 @@
 // Copyright (C) 2022 Samuel Demeulemeester
 //
 
+#include <stdbool.h>
+
 #include "stdint.h"
 #include "string.h"
 #include "display.h"
@@ -14,6 +16,30 @@
 
 #define LINE_DMI 23
 
+#define MAX_DMI_DEVICES     32
+#define MAX_DMI_MAPS        32
+#define LOCATOR_LENGTH      24
+
+typedef struct {
+    uint16_t    handle;
+    uint16_t    array_handle;
+    bool        populated;
+    char        locator[LOCATOR_LENGTH];
+} dmi_device_t;
+
+typedef struct {
+    uint64_t    start;
+    uint64_t    end;
+    uint16_t    handle;     // memory device (type 20) or memory array (type 19)
+} dmi_map_t;
+
+typedef struct {
+    uint64_t    start;
+    uint64_t    end;
+    int         slot;
+    char        name[LOCATOR_LENGTH];
+} dimm_range_t;
+
 static const uint8_t *table_start = NULL;
 static uint32_t table_length = 0; // 16-bit in SMBIOS v2, 32-bit in SMBIOS v3.
 
@@ -26,6 +52,18 @@ struct system_info *dmi_system_info;
 struct baseboard_info *dmi_baseboard_info;
 struct mem_dev *dmi_memory_device;
 
+static dmi_device_t dmi_devices[MAX_DMI_DEVICES];
+static int          num_dmi_devices = 0;
+
+static dmi_map_t    dmi_dev_maps[MAX_DMI_MAPS];
+static int          num_dmi_dev_maps = 0;
+
+static dmi_map_t    dmi_array_maps[MAX_DMI_MAPS];
+static int          num_dmi_array_maps = 0;
+
+static dimm_range_t dimm_ranges[MAX_DIMM_SLOTS];
+static int          num_dimm_ranges = 0;
+
 static char *get_tstruct_string(struct tstruct_header *header, uint16_t maxlen, int n)
 {
     if (n < 1)
@@ -42,6 +80,149 @@ static char *get_tstruct_string(struct tstruct_header *header, uint16_t maxlen,
     return NULL;
 }
 
+static void copy_locator(char *dst, const char *src)
+{
+    int i = 0;
+    if (src != NULL) {
+        while (i < LOCATOR_LENGTH - 1 && src[i] != '\0') {
+            dst[i] = src[i];
+            i++;
+        }
+    }
+    dst[i] = '\0';
+}
+
+static void append_locator(char *dst, const char *src)
+{
+    int i = strlen(dst);
+    if (i < LOCATOR_LENGTH - 2) {
+        dst[i++] = '/';
+        copy_locator(dst + i, src);
+        dst[LOCATOR_LENGTH - 1] = '\0';
+    }
+}
+
+static void get_map_range(uint32_t start_kb, uint32_t end_kb, bool has_ext, uint64_t ext_start, uint64_t ext_end, dmi_map_t *map)
+{
+    if (start_kb == 0xFFFFFFFF && has_ext) {
+        map->start = ext_start;
+        map->end   = ext_end + 1;
+    } else {
+        map->start = (uint64_t)start_kb << 10;
+        map->end   = ((uint64_t)end_kb + 1) << 10;
+    }
+}
+
+static void record_memory_structure(const struct tstruct_header *header)
+{
+    uint16_t struct_length = table_length - ((const uint8_t *)header - table_start);
+
+    if (header->type == 17 && num_dmi_devices < MAX_DMI_DEVICES) {
+        const struct mem_dev *dev = (const struct mem_dev *)header;
+        dmi_device_t *entry = &dmi_devices[num_dmi_devices++];
+        entry->handle       = header->handle;
+        entry->array_handle = dev->pma_handle;
+        entry->populated    = (dev->size != 0 && dev->size != 0xFFFF);
+        copy_locator(entry->locator, get_tstruct_string((struct tstruct_header *)header, struct_length, dev->dev_locator));
+    }
+    if (header->type == 19 && num_dmi_array_maps < MAX_DMI_MAPS) {
+        const struct mem_array_map *map = (const struct mem_array_map *)header;
+        dmi_map_t *entry = &dmi_array_maps[num_dmi_array_maps++];
+        bool has_ext = (header->length >= sizeof(struct mem_array_map));
+        get_map_range(map->start_addr, map->end_addr, has_ext,
+                      has_ext ? map->ext_start_addr : 0, has_ext ? map->ext_end_addr : 0, entry);
+        entry->handle = map->array_handle;
+    }
+    if (header->type == 20 && num_dmi_dev_maps < MAX_DMI_MAPS) {
+        const struct mem_dev_map *map = (const struct mem_dev_map *)header;
+        dmi_map_t *entry = &dmi_dev_maps[num_dmi_dev_maps++];
+        bool has_ext = (header->length >= sizeof(struct mem_dev_map));
+        get_map_range(map->start_addr, map->end_addr, has_ext,
+                      has_ext ? map->ext_start_addr : 0, has_ext ? map->ext_end_addr : 0, entry);
+        entry->handle = map->dev_handle;
+    }
+}
+
+static const dmi_device_t *find_dmi_device(uint16_t handle)
+{
+    for (int i = 0; i < num_dmi_devices; i++) {
+        if (dmi_devices[i].handle == handle) {
+            return &dmi_devices[i];
+        }
+    }
+    return NULL;
+}
+
+static void add_dimm_range(uint64_t start, uint64_t end, const char *locator)
+{
+    if (start >= end || locator[0] == '\0') {
+        return;
+    }
+
+    // Interleaved devices share the same range, so list them all.
+    for (int i = 0; i < num_dimm_ranges; i++) {
+        if (dimm_ranges[i].start == start && dimm_ranges[i].end == end) {
+            append_locator(dimm_ranges[i].name, locator);
+            return;
+        }
+    }
+    if (num_dimm_ranges == MAX_DIMM_SLOTS) {
+        return;
+    }
+
+    // Keep the ranges sorted by start address.
+    int i = num_dimm_ranges++;
+    while (i > 0 && dimm_ranges[i - 1].start > start) {
+        dimm_ranges[i] = dimm_ranges[i - 1];
+        i--;
+    }
+    dimm_ranges[i].start = start;
+    dimm_ranges[i].end   = end;
+    copy_locator(dimm_ranges[i].name, locator);
+}
+
+static void build_dimm_index(void)
+{
+    num_dimm_ranges = 0;
+
+    // Type 20 structures map address ranges directly onto memory devices.
+    for (int i = 0; i < num_dmi_dev_maps; i++) {
+        const dmi_device_t *dev = find_dmi_device(dmi_dev_maps[i].handle);
+        if (dev != NULL && dev->populated) {
+            add_dimm_range(dmi_dev_maps[i].start, dmi_dev_maps[i].end, dev->locator);
+        }
+    }
+
+    // Otherwise fall back to type 19 structures, which only identify a
+    // single slot when exactly one device in the array is populated.
+    if (num_dimm_ranges == 0) {
+        for (int i = 0; i < num_dmi_array_maps; i++) {
+            const dmi_device_t *only_dev = NULL;
+            int num_populated = 0;
+            for (int j = 0; j < num_dmi_devices; j++) {
+                if (dmi_devices[j].array_handle == dmi_array_maps[i].handle && dmi_devices[j].populated) {
+                    only_dev = &dmi_devices[j];
+                    num_populated++;
+                }
+            }
+            if (num_populated == 1) {
+                add_dimm_range(dmi_array_maps[i].start, dmi_array_maps[i].end, only_dev->locator);
+            }
+        }
+    }
+
+    // Ranges belonging to the same slot(s) share the index of the first one.
+    for (int i = 0; i < num_dimm_ranges; i++) {
+        dimm_ranges[i].slot = i;
+        for (int j = 0; j < i; j++) {
+            if (strncmp(dimm_ranges[i].name, dimm_ranges[j].name, LOCATOR_LENGTH) == 0) {
+                dimm_ranges[i].slot = dimm_ranges[j].slot;
+                break;
+            }
+        }
+    }
+}
+
 #ifdef __x86_64__
 static smbiosv2_t *find_smbiosv2_in_efi64_system_table(efi64_system_table_t *system_table)
 {
@@ -152,6 +333,13 @@ static int parse_dmi(uint16_t numstructs)
             }
         }
 
+        // Types 17, 19 & 20 - Memory Device and Mapped Addresses (for the DIMM locator index)
+        if ((header->type == 17 && header->length > offsetof(struct mem_dev, partnum))
+        ||  (header->type == 19 && header->length >= offsetof(struct mem_array_map, ext_start_addr))
+        ||  (header->type == 20 && header->length >= offsetof(struct mem_dev_map, ext_start_addr))) {
+            record_memory_structure(header);
+        }
+
         dmi += header->length;
 
         if (dmi >= table_start + table_length) {
@@ -172,6 +360,9 @@ static int parse_dmi(uint16_t numstructs)
             return -1;
         }
     }
+
+    build_dimm_index();
+
     return 0;
 }
 
@@ -250,3 +441,28 @@ void print_smbios_startup_info(void)
         }
     }
 }
+
+int smbios_dimm_slot(uint64_t addr)
+{
+    int lo = 0;
+    int hi = num_dimm_ranges - 1;
+    while (lo <= hi) {
+        int mid = (lo + hi) / 2;
+        if (addr < dimm_ranges[mid].start) {
+            hi = mid - 1;
+        } else if (addr >= dimm_ranges[mid].end) {
+            lo = mid + 1;
+        } else {
+            return dimm_ranges[mid].slot;
+        }
+    }
+    return -1;
+}
+
+const char *smbios_dimm_slot_name(int slot)
+{
+    if (slot < 0 || slot >= num_dimm_ranges) {
+        return "?";
+    }
+    return dimm_ranges[slot].name;
+}
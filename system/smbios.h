@@ -122,6 +122,34 @@ struct mem_dev {
     uint32_t extended_conf_speed;*/
 } __attribute__((packed));
 
+struct mem_array_map {
+    struct tstruct_header header;
+    uint32_t start_addr;
+    uint32_t end_addr;
+    uint16_t array_handle;
+    uint8_t  partition_width;
+    uint64_t ext_start_addr;    // SMBIOS 2.7+
+    uint64_t ext_end_addr;
+} __attribute__((packed));
+
+struct mem_dev_map {
+    struct tstruct_header header;
+    uint32_t start_addr;
+    uint32_t end_addr;
+    uint16_t dev_handle;
+    uint16_t array_map_handle;
+    uint8_t  partition_row_pos;
+    uint8_t  interleave_pos;
+    uint8_t  interleave_depth;
+    uint64_t ext_start_addr;    // SMBIOS 2.7+
+    uint64_t ext_end_addr;
+} __attribute__((packed));
+
+/**
+ * The maximum number of address ranges in the DIMM locator index.
+ */
+#define MAX_DIMM_SLOTS  16
+
 /**
  * Memory device Structure (used for SPD decoding)
  */
@@ -134,6 +162,20 @@ extern struct mem_dev *dmi_memory_device;
 
 int smbios_init(void);
 
+/**
+ * Returns the index of the DIMM slot containing the physical address addr,
+ * as described by the SMBIOS memory mapping structures, or -1 if unknown.
+ * Addresses in slots with the same locator share the same index.
+ */
+
+int smbios_dimm_slot(uint64_t addr);
+
+/**
+ * Returns the locator name (e.g. "DIMM_A1") of the given DIMM slot index.
+ */
+
+const char *smbios_dimm_slot_name(int slot);
+
 /**
  * Print DMI
  */
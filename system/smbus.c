@@ -17,9 +17,14 @@
 #include "hwquirks.h"
 
 #define LINE_SPD        13
-#define MAX_SPD_SLOT    8
 
-ram_info ram = { 0, 0, 0, 0, 0, 0, "N/A"};
+#define TSENSOR_NONE    0
+#define TSENSOR_TSOD    1   // DDR3/DDR4 JC-42.4 thermal sensor on DIMM
+#define TSENSOR_SPD5    2   // DDR5 SPD5118 hub with integrated thermal sensor
+
+ram_info ram = { 0, 0, 0, 0, 0, 0, "N/A", 0};
+
+spd_info spd_modules[MAX_SPD_SLOT];
 
 int smbdev, smbfun;
 unsigned short smbusbase = 0;
@@ -29,6 +34,11 @@ static uint16_t extra_initial_sleep_for_smb_transaction = 0;
 static int8_t spd_page = -1;
 static int8_t last_adr = -1;
 
+static uint8_t dimm_tsensor[MAX_SPD_SLOT];
+static int dimm_temp[MAX_SPD_SLOT];
+static int next_tsensor_slot = 0;
+static int hottest_dimm_temp = 0;
+
 // Functions Prototypes
 static void read_sku(char *sku, uint8_t slot_idx, uint16_t offset, uint8_t max_len);
 
@@ -40,6 +50,8 @@ static void parse_spd_ddr3  (spd_info *spdi, uint8_t slot_idx);
 static void parse_spd_ddr4  (spd_info *spdi, uint8_t slot_idx);
 static void parse_spd_ddr5  (spd_info *spdi, uint8_t slot_idx);
 static void print_spdi(spd_info spdi, uint8_t lidx);
+static void find_dimm_tsensor(uint8_t slot_idx, uint8_t spd_type);
+static bool read_dimm_temperature(uint8_t slot_idx, int *temp);
 
 static bool setup_smb_controller(void);
 static bool find_smb_controller(uint16_t vid, uint16_t did);
@@ -54,6 +66,8 @@ static bool ich5_get_smb(void);
 static bool ali_get_smb(uint8_t address);
 static uint8_t ich5_process(void);
 static uint8_t ich5_read_spd_byte(uint8_t adr, uint16_t cmd);
+static bool ich5_read_reg_byte(uint8_t smbus_adr, uint8_t reg, uint8_t *value);
+static bool ich5_read_reg_word(uint8_t smbus_adr, uint8_t reg, uint16_t *value);
 static uint8_t nf_read_spd_byte(uint8_t smbus_adr, uint8_t spd_adr);
 static uint8_t ali_m1563_read_spd_byte(uint8_t smbus_adr, uint8_t spd_adr);
 static uint8_t ali_m1543_read_spd_byte(uint8_t smbus_adr, uint8_t spd_adr);
@@ -69,6 +83,7 @@ void print_smbus_startup_info(void)
 
     spd_info curspd;
     ram.freq = 0;
+    ram.num_modules = 0;
     curspd.isValid = false;
 
     if (quirk.type & QUIRK_TYPE_SMBUS) {
@@ -84,8 +99,12 @@ void print_smbus_startup_info(void)
         memset(&curspd, 0, sizeof(curspd));
         curspd.slot_num = spdidx;
 
+        dimm_tsensor[spdidx] = TSENSOR_NONE;
+        dimm_temp[spdidx] = 0;
+
         if (get_spd(spdidx, 0) != 0xFF) {
-            switch(get_spd(spdidx, 2))
+            uint8_t spd_type = get_spd(spdidx, 2);
+            switch(spd_type)
             {
                 default:
                     continue;
@@ -122,11 +141,44 @@ void print_smbus_startup_info(void)
 
                 print_spdi(curspd, spd_line_idx);
                 spd_line_idx++;
+
+                find_dimm_tsensor(spdidx, spd_type);
             }
         }
     }
 }
 
+int poll_dimm_temperature(void)
+{
+    // Only read one sensor per call, to limit the time spent on the SMBus.
+    for (int i = 0; i < MAX_SPD_SLOT; i++) {
+        uint8_t slot_idx = next_tsensor_slot;
+        next_tsensor_slot = (next_tsensor_slot + 1) % MAX_SPD_SLOT;
+
+        if (dimm_tsensor[slot_idx] != TSENSOR_NONE) {
+            // Don't keep showing an old reading if the sensor stops responding.
+            int temp;
+            dimm_temp[slot_idx] = read_dimm_temperature(slot_idx, &temp) ? temp : 0;
+            break;
+        }
+    }
+
+    int hottest = 0;
+    for (int i = 0; i < MAX_SPD_SLOT; i++) {
+        if (dimm_temp[i] > hottest) {
+            hottest = dimm_temp[i];
+        }
+    }
+    hottest_dimm_temp = hottest;
+
+    return hottest;
+}
+
+int get_dimm_temperature(void)
+{
+    return hottest_dimm_temp;
+}
+
 static void print_spdi(spd_info spdi, uint8_t lidx)
 {
     uint8_t curcol;
@@ -184,6 +236,8 @@ static void print_spdi(spd_info spdi, uint8_t lidx)
 
     // Populate global ram var
     ram.type = spdi.type;
+    spd_modules[ram.num_modules] = spdi;
+    ram.num_modules++;
     if (ram.freq == 0 || ram.freq > spdi.freq) {
         ram.freq = spdi.freq;
     }
@@ -1046,6 +1100,85 @@ static void parse_spd_sdram(spd_info *spdi, uint8_t slot_idx)
 // SMBUS Controller Functions
 // --------------------------
 
+// --------------------------------------------
+// DIMM thermal sensors (DDR3/DDR4 TSOD, DDR5 hub)
+// --------------------------------------------
+
+static void find_dimm_tsensor(uint8_t slot_idx, uint8_t spd_type)
+{
+    uint8_t val;
+    uint16_t vid = (smbus_id >> 16) & 0xFFFF;
+
+    // Only the i801-compatible controllers implement word reads here.
+    if (vid == PCI_VID_ALI || vid == PCI_VID_NVIDIA) {
+        return;
+    }
+
+    switch (spd_type) {
+      case 0x12: // DDR5: the SPD5118 hub has a sensor, the SPD5108 does not.
+        if (ich5_read_reg_byte(0x50 + slot_idx, SPD5_MR1, &val) && (val & 0x10)) {
+            dimm_tsensor[slot_idx] = TSENSOR_SPD5;
+        }
+        break;
+      case 0x0C: // DDR4: SPD byte 14 bit 7 flags the thermal sensor.
+        if (get_spd(slot_idx, 14) & 0x80) {
+            dimm_tsensor[slot_idx] = TSENSOR_TSOD;
+        }
+        break;
+      case 0x0B: // DDR3: SPD byte 32 bit 7 flags the thermal sensor.
+        if (get_spd(slot_idx, 32) & 0x80) {
+            dimm_tsensor[slot_idx] = TSENSOR_TSOD;
+        }
+        break;
+      default:
+        break;
+    }
+
+    // Don't trust the flag until a credible temperature has been read.
+    if (dimm_tsensor[slot_idx] != TSENSOR_NONE && !read_dimm_temperature(slot_idx, &dimm_temp[slot_idx])) {
+        dimm_tsensor[slot_idx] = TSENSOR_NONE;
+    }
+}
+
+static bool read_dimm_temperature(uint8_t slot_idx, int *temp)
+{
+    uint16_t raw;
+
+    switch (dimm_tsensor[slot_idx]) {
+      case TSENSOR_TSOD:
+        if (!ich5_read_reg_word(TSOD_BASE_ADR + slot_idx, TSOD_TEMP_REG, &raw)) {
+            return false;
+        }
+        // The TSOD sends the most significant byte first.
+        raw = (raw << 8) | (raw >> 8);
+        break;
+      case TSENSOR_SPD5: {
+        uint8_t lo, hi;
+        if (!ich5_read_reg_byte(0x50 + slot_idx, SPD5_MR49, &lo)
+         || !ich5_read_reg_byte(0x50 + slot_idx, SPD5_MR50, &hi)) {
+            return false;
+        }
+        raw = (hi << 8) | lo;
+        break;
+      }
+      default:
+        return false;
+    }
+
+    // Both report a 13-bit two's complement value in 1/16 degree C units.
+    int val = raw & 0x1FFF;
+    if (val & 0x1000) {
+        val -= 0x2000;
+    }
+    val /= 16;
+
+    if (val <= 0 || val > 125) {
+        return false;
+    }
+    *temp = val;
+    return true;
+}
+
 static bool setup_smb_controller(void)
 {
     uint16_t vid, did;
@@ -1562,6 +1695,34 @@ static uint8_t ich5_read_spd_byte(uint8_t smbus_adr, uint16_t spd_adr)
     }
 }
 
+// The DIMM thermal sensor registers are only read, never written.
+
+static bool ich5_read_reg_byte(uint8_t smbus_adr, uint8_t reg, uint8_t *value)
+{
+    __outb((smbus_adr << 1) | I2C_READ, SMBHSTADD);
+    __outb(reg, SMBHSTCMD);
+    __outb(SMBHSTCNT_BYTE_DATA, SMBHSTCNT);
+
+    if (ich5_process() != 0) {
+        return false;
+    }
+    *value = __inb(SMBHSTDAT0);
+    return true;
+}
+
+static bool ich5_read_reg_word(uint8_t smbus_adr, uint8_t reg, uint16_t *value)
+{
+    __outb((smbus_adr << 1) | I2C_READ, SMBHSTADD);
+    __outb(reg, SMBHSTCMD);
+    __outb(SMBHSTCNT_WORD_DATA, SMBHSTCNT);
+
+    if (ich5_process() != 0) {
+        return false;
+    }
+    *value = __inb(SMBHSTDAT0) | (__inb(SMBHSTDAT1) << 8);
+    return true;
+}
+
 static uint8_t ich5_process(void)
 {
     uint8_t status;
@@ -13,7 +13,13 @@
 #define I2C_WRITE   0
 #define I2C_READ    1
 
+#define SPD5_MR1  1
 #define SPD5_MR11 11
+#define SPD5_MR49 49
+#define SPD5_MR50 50
+
+#define TSOD_BASE_ADR   0x18
+#define TSOD_TEMP_REG   0x05
 
 /* i801 Hosts Addresses */
 #define SMBHSTSTS   smbusbase
@@ -146,14 +152,42 @@ typedef struct ram_infos {
     uint16_t    tRP;
     uint16_t    tRAS;
     char        *type;
+    uint8_t     num_modules;
 } ram_info;
 
 extern ram_info ram;
 
+/**
+ * The maximum number of memory modules whose SPD is read.
+ */
+#define MAX_SPD_SLOT    8
+
+/**
+ * The SPD information of each valid module found, in slot order. The
+ * number of valid entries is given by ram.num_modules.
+ */
+extern spd_info spd_modules[MAX_SPD_SLOT];
+
 /**
  * Print SMBUS Info
  */
 
 void print_smbus_startup_info(void);
 
+/**
+ * Reads the temperature sensor of the next DIMM in turn, so each call only
+ * makes one or two SMBus transactions. Returns the hottest temperature (in
+ * degrees C) last read from any DIMM, or 0 if no DIMM temperature sensor
+ * was found or none could be read. A sensor that fails to respond no longer
+ * contributes its previous reading. Must only be called by the master CPU.
+ */
+int poll_dimm_temperature(void);
+
+/**
+ * Returns the hottest temperature (in degrees C) last read by
+ * poll_dimm_temperature(), or 0 if none is known. Does not access the
+ * SMBus, so may be called by any CPU.
+ */
+int get_dimm_temperature(void);
+
 #endif // SMBUS_H
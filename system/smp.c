@@ -101,6 +101,16 @@
 #define MADT_PF_ENABLED             0x1
 #define MADT_PF_ONLINE_CAPABLE      0x2
 
+// SRAT entry types
+
+#define SRAT_PROCESSOR_APIC         0
+#define SRAT_MEMORY                 1
+#define SRAT_PROCESSOR_X2APIC       2
+
+// SRAT entry flags
+
+#define SRAT_ENABLED                0x1
+
 // Private memory heap used for AP trampoline and synchronisation objects
 
 #define HEAP_BASE_ADDR              (smp_heap_page << PAGE_SHIFT)
@@ -214,6 +224,53 @@ typedef struct {
     uint64_t    lapic_addr;
 } madt_lapic_addr_entry_t;
 
+typedef struct {
+    char        signature[4];   // "SRAT"
+    uint32_t    length;
+    uint8_t     revision;
+    uint8_t     checksum;
+    char        oem_id[6];
+    char        oem_table_id[8];
+    char        oem_revision[4];
+    char        creator_id[4];
+    char        creator_revision[4];
+    uint32_t    reserved[3];
+} srat_table_header_t;
+
+typedef struct {
+    uint8_t     type;
+    uint8_t     length;
+    uint8_t     domain_lo;
+    uint8_t     apic_id;
+    uint32_t    flags;
+    uint8_t     sapic_eid;
+    uint8_t     domain_hi[3];
+    uint32_t    clock_domain;
+} srat_processor_entry_t;
+
+typedef struct __attribute__((packed)) {
+    uint8_t     type;
+    uint8_t     length;
+    uint32_t    domain;
+    uint16_t    reserved1;
+    uint64_t    base_addr;
+    uint64_t    length_bytes;
+    uint32_t    reserved2;
+    uint32_t    flags;
+    uint64_t    reserved3;
+} srat_memory_entry_t;
+
+typedef struct __attribute__((packed)) {
+    uint8_t     type;
+    uint8_t     length;
+    uint16_t    reserved1;
+    uint32_t    domain;
+    uint32_t    x2apic_id;
+    uint32_t    flags;
+    uint32_t    clock_domain;
+    uint32_t    reserved2;
+} srat_x2apic_entry_t;
+
 //------------------------------------------------------------------------------
 // Private Variables
 //------------------------------------------------------------------------------
@@ -228,12 +285,22 @@ static uintptr_t        smp_heap_page = 0;
 
 static uintptr_t        alloc_addr = 0;
 
+static uint32_t         numa_domain[MAX_NUMA_NODES];
+
+static uint8_t          cpu_numa_node[MAX_CPUS];
+
 //------------------------------------------------------------------------------
 // Variables
 //------------------------------------------------------------------------------
 
 int num_available_cpus = 1;  // There is always at least one CPU, the BSP
 
+int num_numa_nodes = 0;
+
+numa_range_t numa_ranges[MAX_NUMA_RANGES];
+
+int num_numa_ranges = 0;
+
 //------------------------------------------------------------------------------
 // Private Functions
 //------------------------------------------------------------------------------
@@ -427,6 +494,86 @@ static bool find_cpus_in_madt(void)
     return true;
 }
 
+static int numa_node(uint32_t domain)
+{
+    for (int node = 0; node < num_numa_nodes; node++) {
+        if (numa_domain[node] == domain) {
+            return node;
+        }
+    }
+    if (num_numa_nodes == MAX_NUMA_NODES) {
+        return -1;
+    }
+    numa_domain[num_numa_nodes] = domain;
+    return num_numa_nodes++;
+}
+
+static void set_cpu_numa_node(uint32_t apic_id, uint32_t domain, uint32_t flags)
+{
+    int node = (flags & SRAT_ENABLED) ? numa_node(domain) : -1;
+    if (node < 0) {
+        return;
+    }
+    for (int i = 0; i < num_available_cpus; i++) {
+        if (cpu_num_to_apic_id[i] == apic_id) {
+            cpu_numa_node[i] = node;
+        }
+    }
+}
+
+static void parse_srat(void)
+{
+    if (acpi_config.srat_addr == 0) {
+        return;
+    }
+
+    srat_table_header_t *srat = (srat_table_header_t *)map_region(acpi_config.srat_addr, sizeof(srat_table_header_t), true);
+    if (srat == NULL) return;
+
+    srat = (srat_table_header_t *)map_region(acpi_config.srat_addr, srat->length, true);
+    if (srat == NULL) return;
+
+    if (acpi_checksum(srat, srat->length) != 0) {
+        return;
+    }
+
+    uint8_t *tab_entry_ptr = (uint8_t *)srat + sizeof(srat_table_header_t);
+    uint8_t *srat_table_end = (uint8_t *)srat + srat->length;
+    while (tab_entry_ptr < srat_table_end) {
+        madt_entry_header_t *entry_header = (madt_entry_header_t *)tab_entry_ptr;
+        if (entry_header->length == 0) {
+            break;
+        }
+        if (entry_header->type == SRAT_PROCESSOR_APIC) {
+            srat_processor_entry_t *entry = (srat_processor_entry_t *)tab_entry_ptr;
+            uint32_t domain = entry->domain_lo;
+            if (srat->revision >= 2) {
+                domain |= entry->domain_hi[0] << 8 | entry->domain_hi[1] << 16 | entry->domain_hi[2] << 24;
+            }
+            set_cpu_numa_node(entry->apic_id, domain, entry->flags);
+        }
+        if (entry_header->type == SRAT_PROCESSOR_X2APIC) {
+            // Firmware may describe any processor this way, not just those
+            // whose APIC ID doesn't fit in 8 bits (which we can't start).
+            srat_x2apic_entry_t *entry = (srat_x2apic_entry_t *)tab_entry_ptr;
+            set_cpu_numa_node(entry->x2apic_id, entry->domain, entry->flags);
+        }
+        if (entry_header->type == SRAT_MEMORY) {
+            srat_memory_entry_t *entry = (srat_memory_entry_t *)tab_entry_ptr;
+            int node = (entry->flags & SRAT_ENABLED) ? numa_node(entry->domain) : -1;
+            uint64_t end_addr = entry->base_addr + entry->length_bytes;
+            if (node >= 0 && entry->length_bytes > 0 && num_numa_ranges < MAX_NUMA_RANGES
+            &&  (end_addr >> PAGE_SHIFT) <= UINTPTR_MAX) {
+                numa_ranges[num_numa_ranges].start = entry->base_addr >> PAGE_SHIFT;
+                numa_ranges[num_numa_ranges].end   = end_addr >> PAGE_SHIFT;
+                numa_ranges[num_numa_ranges].node  = node;
+                num_numa_ranges++;
+            }
+        }
+        tab_entry_ptr += entry_header->length;
+    }
+}
+
 static inline void send_ipi(int apic_id, int trigger, int level, int mode, uint8_t vector)
 {
     apic_write(APIC_REG_ICRHI, apic_id << 24);
@@ -555,6 +702,13 @@ void smp_init(bool smp_enable)
         apic_id_to_cpu_num[cpu_num_to_apic_id[i]] = i;
     }
 
+    num_numa_nodes  = 0;
+    num_numa_ranges = 0;
+    for (int i = 0; i < MAX_CPUS; i++) {
+        cpu_numa_node[i] = 0;
+    }
+    parse_srat();
+
     // Allocate a page of low memory for AP trampoline and sync objects.
     // These need to remain pinned in place during relocation.
     smp_heap_page = heap_alloc(HEAP_TYPE_LM_1, PAGE_SIZE, PAGE_SIZE) >> PAGE_SHIFT;
@@ -623,6 +777,11 @@ int smp_my_cpu_num(void)
     return num_available_cpus > 1 ? apic_id_to_cpu_num[my_apic_id()] : 0;
 }
 
+int smp_cpu_numa_node(int cpu_num)
+{
+    return cpu_numa_node[cpu_num];
+}
+
 barrier_t *smp_alloc_barrier(int num_threads)
 {
     barrier_t *barrier = (barrier_t  *)(alloc_addr);
@@ -23,6 +23,10 @@
  */
 #define MAX_CPUS       (1 + MAX_APS)
 
+#define MAX_NUMA_NODES  8
+
+#define MAX_NUMA_RANGES 32
+
 /**
  * The current state of a CPU core.
  */
@@ -38,6 +42,31 @@ typedef enum  __attribute__ ((packed)) {
  */
 extern int num_available_cpus;
 
+/**
+ * A physical memory range (in pages) belonging to a NUMA node.
+ */
+typedef struct {
+    uintptr_t   start;
+    uintptr_t   end;
+    int         node;
+} numa_range_t;
+
+/**
+ * The number of NUMA nodes described by the ACPI SRAT, or 0 if there is no
+ * SRAT. The nodes are numbered from 0 in the order they appear in the SRAT.
+ */
+extern int num_numa_nodes;
+
+/**
+ * The memory ranges described by the ACPI SRAT.
+ */
+extern numa_range_t numa_ranges[MAX_NUMA_RANGES];
+
+/**
+ * The number of entries in numa_ranges.
+ */
+extern int num_numa_ranges;
+
 /**
  * Initialises the SMP state and detects the number of available CPU cores.
  */
@@ -60,6 +89,11 @@ void smp_send_nmi(int cpu_num);
  */
 int smp_my_cpu_num(void);
 
+/**
+ * Returns the NUMA node of the specified CPU, or 0 if it is unknown.
+ */
+int smp_cpu_numa_node(int cpu_num);
+
 /**
  * Allocates and initialises a barrier object in pinned memory.
  */
@@ -0,0 +1,162 @@
+// SPDX-License-Identifier: GPL-2.0
+// Copyright (C) 2004-2023 Sam Demeulemeester
+//
+// ------------------------
+//
+// Per-CPU thermal throttle and effective frequency monitor
+//
+// The thermal status registers latch a log flag whenever the core (or the
+// package) has been throttled because it reached its thermal limit or because
+// PROCHOT# was asserted. The flags are sticky until written with zero, so
+// each sample counts and clears them.
+//
+// APERF counts at the actual core clock and MPERF at the TSC (nominal) rate,
+// both only while the core is in C0, so the ratio of their increments scales
+// the TSC frequency to the average frequency the core ran at.
+//
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "cpuid.h"
+#include "cpuinfo.h"
+#include "msr.h"
+#include "smp.h"
+
+#include "config.h"
+
+#include "throttle.h"
+
+//------------------------------------------------------------------------------
+// Constants
+//------------------------------------------------------------------------------
+
+#define MIN_SAMPLE_PERIOD       10      // milliseconds
+
+#define CPUID_6_EAX_DTS         (1 << 0)
+#define CPUID_6_EAX_PTM         (1 << 6)
+#define CPUID_6_ECX_APERFMPERF  (1 << 0)
+
+#define THERM_STATUS_LOG        (1 << 1)
+#define THERM_PROCHOT_LOG       (1 << 3)
+
+//------------------------------------------------------------------------------
+// Private Variables
+//------------------------------------------------------------------------------
+
+static bool     core_status = false;
+static bool     package_status = false;
+static bool     aperf_mperf = false;
+
+static uint64_t prev_aperf[MAX_CPUS];
+static uint64_t prev_mperf[MAX_CPUS];
+
+//------------------------------------------------------------------------------
+// Private Functions
+//------------------------------------------------------------------------------
+
+static uint64_t read_msr64(uint32_t msr)
+{
+    uint32_t lo, hi;
+
+    rdmsr(msr, lo, hi);
+    return (uint64_t)hi << 32 | lo;
+}
+
+static int read_and_clear_log(uint32_t msr)
+{
+    uint32_t lo, hi;
+
+    rdmsr(msr, lo, hi);
+    int num_flags = 0;
+    if (lo & THERM_STATUS_LOG) {
+        num_flags++;
+    }
+    if (lo & THERM_PROCHOT_LOG) {
+        num_flags++;
+    }
+    if (num_flags > 0) {
+        // The log flags are cleared by writing zero. The other flags are read-only.
+        wrmsr(msr, 0, 0);
+    }
+    return num_flags;
+}
+
+//------------------------------------------------------------------------------
+// Public Functions
+//------------------------------------------------------------------------------
+
+void throttle_init(void)
+{
+    core_status = false;
+    package_status = false;
+    aperf_mperf = false;
+
+    if (!enable_mch_read || !cpuid_info.flags.msr || cpuid_info.max_cpuid < 6) {
+        return;
+    }
+
+    uint32_t eax, ebx, ecx, edx;
+    cpuid(6, 0, &eax, &ebx, &ecx, &edx);
+
+    // The thermal status registers are Intel-specific.
+    if (cpuid_info.vendor_id.str[0] == 'G') {
+        core_status    = (eax & CPUID_6_EAX_DTS) != 0;
+        package_status = (eax & CPUID_6_EAX_PTM) != 0;
+    }
+    aperf_mperf = (ecx & CPUID_6_ECX_APERFMPERF) != 0;
+
+    for (int i = 0; i < MAX_CPUS; i++) {
+        prev_aperf[i] = 0;
+        prev_mperf[i] = 0;
+    }
+}
+
+bool throttle_status_supported(void)
+{
+    return core_status;
+}
+
+bool throttle_freq_supported(void)
+{
+    return aperf_mperf && clks_per_msec > 0;
+}
+
+int throttle_poll(int my_cpu, uint32_t *eff_khz)
+{
+    int num_events = 0;
+
+    if (core_status) {
+        num_events += read_and_clear_log(MSR_IA32_THERM_STATUS);
+    }
+    if (package_status) {
+        // The package flags are shared, so are counted by whichever CPU sees them first.
+        num_events += read_and_clear_log(MSR_IA32_PACKAGE_THERM_STATUS);
+    }
+
+    *eff_khz = 0;
+    if (!throttle_freq_supported()) {
+        return num_events;
+    }
+
+    uint64_t mperf = read_msr64(MSR_IA32_MPERF);
+    uint64_t aperf = read_msr64(MSR_IA32_APERF);
+    uint64_t mperf_delta = mperf - prev_mperf[my_cpu];
+    uint64_t aperf_delta = aperf - prev_aperf[my_cpu];
+    if (prev_mperf[my_cpu] == 0 || mperf < prev_mperf[my_cpu]) {
+        // First sample, or the counters have been reset: restart the interval.
+        prev_mperf[my_cpu] = mperf;
+        prev_aperf[my_cpu] = aperf;
+        return num_events;
+    }
+    if (mperf_delta < (uint64_t)MIN_SAMPLE_PERIOD * clks_per_msec) {
+        // Too short an interval to be accurate: extend it to the next sample.
+        return num_events;
+    }
+    prev_mperf[my_cpu] = mperf;
+    prev_aperf[my_cpu] = aperf;
+
+    *eff_khz = (aperf_delta * clks_per_msec) / mperf_delta;
+
+    return num_events;
+}
@@ -0,0 +1,43 @@
+// SPDX-License-Identifier: GPL-2.0
+#ifndef THROTTLE_H
+#define THROTTLE_H
+/**
+ * \file
+ *
+ * Provides per-CPU monitoring of thermal throttling and of the effective
+ * core frequency.
+ *
+ *//*
+ * Copyright (C) 2004-2023 Sam Demeulemeester.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * Determines whether the throttle status flags and the effective frequency
+ * counters are available. As a virtual machine may not implement these
+ * registers, this should only be called when the user has asked for them
+ * to be used.
+ */
+void throttle_init(void);
+
+/**
+ * Returns true if thermal throttling can be detected on this CPU.
+ */
+bool throttle_status_supported(void);
+
+/**
+ * Returns true if the effective frequency can be measured on this CPU.
+ */
+bool throttle_freq_supported(void);
+
+/**
+ * Reads and clears the throttle status log flags of the calling CPU and
+ * returns the number of flags found set. If enough time has passed since
+ * the previous sample, also stores the average effective frequency (in kHz)
+ * since then in eff_khz, otherwise stores 0.
+ */
+int throttle_poll(int my_cpu, uint32_t *eff_khz);
+
+#endif // THROTTLE_H
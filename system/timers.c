@@ -1,6 +1,14 @@
 // SPDX-License-Identifier: GPL-2.0
 // Copyright (C) 2020-2022 Martin Whitaker.
 // Copyright (C) 2004-2022 Sam Demeulemeester.
+//
+// The TSC frequency is taken from the CPUID time stamp counter leaves where
+// the CPU reports it. Otherwise it is measured against the first working
+// timer found in the order HPET, ACPI PM timer, PIT. The HPET and ACPI PM
+// timer have a known frequency and can be read at any time, so the TSC is
+// measured over a short interval that starts on a timer edge. The PIT is
+// only used as a last resort, as it needs a longer measurement to achieve
+// the same accuracy.
 
 #include <stdbool.h>
 #include <stddef.h>
@@ -10,60 +18,203 @@
 #include "cpuid.h"
 #include "cpuinfo.h"
 #include "io.h"
+#include "memrw32.h"
 #include "tsc.h"
+#include "vmem.h"
+
+#include "timers.h"
 
 //------------------------------------------------------------------------------
 // Constants
 //------------------------------------------------------------------------------
 
 #define PIT_TICKS_50mS      59659       // PIT clock is 1.193182MHz
-#define APIC_TICKS_50mS     178977      // APIC clock is 3.579545MHz
+
+#define PM_TIMER_FREQ       3579545     // ACPI PM timer clock is 3.579545MHz
+#define PM_TIMER_MASK       0xffffff    // the counter may only be 24 bits wide
+
+#define HPET_REGS_SIZE      0x400
+#define HPET_CAP_REG_HI     0x004       // upper half holds the clock period in fs
+#define HPET_CFG_REG        0x010
+#define HPET_COUNTER_REG    0x0f0
+#define HPET_CFG_ENABLE     0x1
+#define HPET_MAX_PERIOD     100000000   // 100ns, in fs
+
+#define MEASURE_MSEC        10
+#define MEASURE_MAX_LOOPS   1000000     // bounds the measurement if a timer stops
+
+#define MIN_CLKS_PER_MSEC   1000        // anything slower than 1MHz is not credible
+
+//------------------------------------------------------------------------------
+// Private Variables
+//------------------------------------------------------------------------------
+
+static uintptr_t pm_timer_addr = 0;
+
+static uintptr_t hpet_regs = 0;
+
+//------------------------------------------------------------------------------
+// Public Variables
+//------------------------------------------------------------------------------
+
+const char *tsc_source = "none";
 
 //------------------------------------------------------------------------------
 // Private Functions
 //------------------------------------------------------------------------------
 
-static void correct_tsc(void)
+static uint32_t read_pm_timer_io(void)
+{
+    return inl(pm_timer_addr);
+}
+
+static uint32_t read_pm_timer_mmio(void)
+{
+    return read32((uint32_t *)pm_timer_addr);
+}
+
+static uint32_t read_hpet(void)
+{
+    return read32((uint32_t *)(hpet_regs + HPET_COUNTER_REG));
+}
+
+static bool set_tsc_freq(uint64_t clks, const char *source)
+{
+    // Make sure we have a credible result
+    if (clks < MIN_CLKS_PER_MSEC || clks > UINT32_MAX) {
+        return false;
+    }
+    clks_per_msec = clks;
+    tsc_source = source;
+    return true;
+}
+
+static uint64_t measure_tsc(uint32_t (*read_timer)(void), uint32_t mask, uint32_t ticks, uint32_t *elapsed_ticks)
 {
-    uint32_t start_time, end_time, run_time, counter;
     int loops = 0;
 
-    if (cpuid_info.flags.rdtsc == 0) {
-        return;
+    // Start on a timer edge, which also makes sure the timer is running.
+    uint32_t start_count = read_timer() & mask;
+    uint32_t count;
+    do {
+        count = read_timer() & mask;
+        if (++loops > MEASURE_MAX_LOOPS) {
+            return 0;
+        }
+    } while (count == start_count);
+
+    uint64_t start_time = get_tsc();
+    start_count = count;
+
+    uint32_t elapsed;
+    do {
+        elapsed = (read_timer() - start_count) & mask;
+        if (++loops > MEASURE_MAX_LOOPS) {
+            return 0;
+        }
+    } while (elapsed < ticks);
+
+    uint64_t end_time = get_tsc();
+
+    *elapsed_ticks = elapsed;
+    return end_time - start_time;
+}
+
+static bool calibrate_from_cpuid(void)
+{
+    if (cpuid_info.vendor_id.str[0] != 'G' || cpuid_info.max_cpuid < 0x15) {
+        return false;
+    }
+
+    uint32_t denominator, numerator, crystal_hz, reg;
+    cpuid(0x15, 0, &denominator, &numerator, &crystal_hz, &reg);
+    if (denominator == 0 || numerator == 0) {
+        return false;
+    }
+
+    if (crystal_hz != 0) {
+        return set_tsc_freq(((uint64_t)crystal_hz * numerator / denominator) / 1000, "CPUID 0x15");
     }
 
-    // If available, use APIC Timer to find TSC correction factor
-    if (acpi_config.pm_is_io && acpi_config.pm_addr != 0) {
-        rdtscl(start_time);
+    // The crystal frequency is not reported, but the TSC runs at the nominal
+    // (base) core frequency, which is.
+    if (cpuid_info.max_cpuid >= 0x16) {
+        uint32_t base_mhz;
+        cpuid(0x16, 0, &base_mhz, &reg, &reg, &reg);
+        base_mhz &= 0xffff;
+        return set_tsc_freq(base_mhz * 1000, "CPUID 0x16");
+    }
+    return false;
+}
+
+static bool calibrate_from_hpet(void)
+{
+    if (acpi_config.hpet_base == 0) {
+        return false;
+    }
+    hpet_regs = map_region(acpi_config.hpet_base, HPET_REGS_SIZE, true);
+    if (hpet_regs == 0) {
+        return false;
+    }
 
-        counter = inl(acpi_config.pm_addr);
+    uint32_t period_fs = read32((uint32_t *)(hpet_regs + HPET_CAP_REG_HI));
+    if (period_fs == 0 || period_fs > HPET_MAX_PERIOD) {
+        return false;
+    }
 
-        // Generate a dirty delay
-        for(volatile uint8_t i=0; i<100u; i++);
+    // The firmware may have left the main counter halted.
+    uint32_t config = read32((uint32_t *)(hpet_regs + HPET_CFG_REG));
+    if (!(config & HPET_CFG_ENABLE)) {
+        write32((uint32_t *)(hpet_regs + HPET_CFG_REG), config | HPET_CFG_ENABLE);
+    }
 
-        // Make sure counter is incrementing
-        if (inl(acpi_config.pm_addr) > counter) {
+    uint32_t ticks = (MEASURE_MSEC * 1000000000000ULL) / period_fs;
+    uint32_t elapsed_ticks = 0;
+    uint64_t run_time = measure_tsc(read_hpet, 0xffffffff, ticks, &elapsed_ticks);
 
-            while (1) {
-                if (inl(acpi_config.pm_addr) > (counter + APIC_TICKS_50mS) || loops > 1000000) {
-                    break;
-                }
-                loops++;
-            }
+    if (!(config & HPET_CFG_ENABLE)) {
+        write32((uint32_t *)(hpet_regs + HPET_CFG_REG), config);
+    }
 
-            rdtscl(end_time);
+    uint64_t elapsed_ps = ((uint64_t)elapsed_ticks * period_fs) / 1000;
+    if (run_time == 0 || elapsed_ps == 0) {
+        return false;
+    }
+    return set_tsc_freq((run_time * 1000000000) / elapsed_ps, "HPET");
+}
 
-            run_time = end_time - start_time;
+static bool calibrate_from_pm_timer(void)
+{
+    if (acpi_config.pm_addr == 0) {
+        return false;
+    }
 
-            // Make sure we have a credible result
-            if (loops >= 10 && run_time >= 50000) {
-               clks_per_msec = run_time / 50;
-               return;
-            }
+    uint32_t (*read_timer)(void);
+    if (acpi_config.pm_is_io) {
+        pm_timer_addr = acpi_config.pm_addr;
+        read_timer = read_pm_timer_io;
+    } else {
+        pm_timer_addr = map_region(acpi_config.pm_addr, sizeof(uint32_t), true);
+        if (pm_timer_addr == 0) {
+            return false;
         }
+        read_timer = read_pm_timer_mmio;
+    }
+
+    uint32_t ticks = (MEASURE_MSEC * PM_TIMER_FREQ) / 1000;
+    uint32_t elapsed_ticks = 0;
+    uint64_t run_time = measure_tsc(read_timer, PM_TIMER_MASK, ticks, &elapsed_ticks);
+    if (run_time == 0) {
+        return false;
     }
+    return set_tsc_freq((run_time * PM_TIMER_FREQ) / (elapsed_ticks * 1000ULL), "ACPI PM timer");
+}
+
+static bool calibrate_from_pit(void)
+{
+    uint32_t start_time, end_time, run_time;
+    int loops = 0;
 
-    // Use PIT Timer to find TSC correction factor if APIC not available
     outb((inb(0x61) & ~0x02) | 0x01, 0x61);
     outb(0xb0, 0x43);
     outb(PIT_TICKS_50mS & 0xff, 0x42);
@@ -71,7 +222,6 @@ static void correct_tsc(void)
 
     rdtscl(start_time);
 
-    loops = 0;
     do {
         loops++;
     } while ((inb(0x61) & 0x20) == 0);
@@ -80,10 +230,28 @@ static void correct_tsc(void)
 
     run_time = end_time - start_time;
 
-    // Make sure we have a credible result
-    if (loops >= 4 && run_time >= 50000) {
-       clks_per_msec = run_time / 50;
+    if (loops < 4) {
+        return false;
+    }
+    return set_tsc_freq(run_time / 50, "PIT");
+}
+
+static void correct_tsc(void)
+{
+    if (cpuid_info.flags.rdtsc == 0) {
+        return;
+    }
+
+    if (calibrate_from_cpuid()) {
+        return;
+    }
+    if (calibrate_from_hpet()) {
+        return;
+    }
+    if (calibrate_from_pm_timer()) {
+        return;
     }
+    calibrate_from_pit();
 }
 
 //------------------------------------------------------------------------------
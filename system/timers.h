@@ -11,6 +11,10 @@
  * Copyright (C) 2004-2022 Sam Demeulemeester
  */
 
+/**
+ * The source used to determine the TSC frequency (for debug).
+ */
+extern const char *tsc_source;
 
 /**
  * Initialize timers (to correct TSC frequency)
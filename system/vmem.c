@@ -16,6 +16,7 @@
 #include "boot.h"
 
 #include "cpuid.h"
+#include "msr.h"
 
 #include "vmem.h"
 
@@ -37,6 +38,17 @@
 #define VM_REGION_END       (VM_REGION_START + MAX_REGION_PAGES * VM_PAGE_SIZE - 1)
 #define VM_SPACE_END        0xffffffff
 
+// Page directory entry flags for a 2MB page. We reprogram PAT entry 4, which
+// is selected by setting the PAT bit alone and is unused by the default page
+// tables, to be write-combining.
+
+#define PDE_FLAGS           0x83    // present, writable, 2MB page
+#define PDE_PAT             0x1000
+
+#define MSR_IA32_PAT        0x277
+#define PAT_ENTRY4_MASK     0x000000ff  // in the upper half of the MSR
+#define PAT_TYPE_WC         0x01
+
 //------------------------------------------------------------------------------
 // Private Variables
 //------------------------------------------------------------------------------
@@ -45,6 +57,8 @@ static unsigned int device_pages_used = 0;
 
 static uintptr_t    mapped_window = 2;
 
+static bool         pat_wc_enabled = false;
+
 //------------------------------------------------------------------------------
 // Private Functions
 //------------------------------------------------------------------------------
@@ -70,27 +84,41 @@ static void load_pdbr()
     );
 }
 
-//------------------------------------------------------------------------------
-// Public Functions
-//------------------------------------------------------------------------------
-
-uintptr_t map_region(uintptr_t base_addr, size_t size, bool only_for_startup)
+static uintptr_t map_pages(uintptr_t base_addr, size_t size, bool only_for_startup, uint64_t flags)
 {
     uintptr_t last_addr = base_addr + size - 1;
     // Check if the requested region is permanently mapped. If it is only needed during startup,
     // this includes the region we will eventually use for the memory test window.
-    if (last_addr < (only_for_startup ? VM_REGION_START : VM_WINDOW_START) || (base_addr > VM_REGION_END && last_addr <= VM_SPACE_END)) {
+    if (last_addr < (only_for_startup ? VM_REGION_START : VM_WINDOW_START)) {
         return base_addr;
     }
-    // Check if the requested region is already mapped.
+    if (base_addr > VM_REGION_END && last_addr <= VM_SPACE_END) {
+        // This is identity mapped by the last part of pd3, so just update the page attributes.
+        // Only change the pages the region fully covers, as the rest may hold other devices.
+        if (flags != PDE_FLAGS) {
+            uintptr_t first_page = base_addr >> VM_PAGE_SHIFT;
+            uintptr_t last_page  = last_addr >> VM_PAGE_SHIFT;
+            if (base_addr % VM_PAGE_SIZE != 0) {
+                first_page++;
+            }
+            if (last_addr % VM_PAGE_SIZE != VM_PAGE_SIZE - 1) {
+                last_page--;
+            }
+            for (uintptr_t page = first_page; page <= last_page; page++) {
+                pd3[page - (VM_REGION_START >> VM_PAGE_SHIFT)] = ((uint64_t)page << VM_PAGE_SHIFT) + flags;
+            }
+            load_pdbr();
+        }
+        return base_addr;
+    }
+    // Check if the requested region is already mapped with the same attributes.
     uintptr_t first_virt_page = 0;
     uintptr_t first_phys_page = base_addr >> VM_PAGE_SHIFT;
     uintptr_t last_phys_page  = last_addr >> VM_PAGE_SHIFT;
     uintptr_t curr_virt_page  = first_virt_page;
     uintptr_t curr_phys_page  = first_phys_page;
     while (curr_virt_page < device_pages_used && curr_phys_page <= last_phys_page) {
-        uintptr_t mapped_phys_page = pd3[curr_virt_page++] >> VM_PAGE_SHIFT;
-        if (mapped_phys_page == curr_phys_page) {
+        if (pd3[curr_virt_page++] == ((uint64_t)curr_phys_page << VM_PAGE_SHIFT) + flags) {
             curr_phys_page++;
         } else {
             first_virt_page = curr_virt_page;
@@ -100,7 +128,7 @@ uintptr_t map_region(uintptr_t base_addr, size_t size, bool only_for_startup)
     // If not, map it. Note that this will extend a partial match at the end of the current map.
     while (curr_phys_page <= last_phys_page) {
         if (device_pages_used == MAX_REGION_PAGES) return 0;
-        pd3[device_pages_used++] = (curr_phys_page++ << VM_PAGE_SHIFT) + 0x83;
+        pd3[device_pages_used++] = ((uint64_t)curr_phys_page++ << VM_PAGE_SHIFT) + flags;
     }
     // Reload the PDBR to flush any remnants of the old mapping.
     load_pdbr();
@@ -108,6 +136,34 @@ uintptr_t map_region(uintptr_t base_addr, size_t size, bool only_for_startup)
     return VM_REGION_START + first_virt_page * VM_PAGE_SIZE + base_addr % VM_PAGE_SIZE;
 }
 
+//------------------------------------------------------------------------------
+// Public Functions
+//------------------------------------------------------------------------------
+
+void pat_init(void)
+{
+    // Without PAE, paging is not enabled, so there is nothing to gain.
+    if (cpuid_info.flags.pat == 0 || cpuid_info.flags.pae == 0) {
+        return;
+    }
+    uint32_t pat_lo, pat_hi;
+    rdmsr(MSR_IA32_PAT, pat_lo, pat_hi);
+    pat_hi = (pat_hi & ~PAT_ENTRY4_MASK) | PAT_TYPE_WC;
+    wrmsr(MSR_IA32_PAT, pat_lo, pat_hi);
+
+    pat_wc_enabled = true;
+}
+
+uintptr_t map_region(uintptr_t base_addr, size_t size, bool only_for_startup)
+{
+    return map_pages(base_addr, size, only_for_startup, PDE_FLAGS);
+}
+
+uintptr_t map_region_wc(uintptr_t base_addr, size_t size)
+{
+    return map_pages(base_addr, size, false, pat_wc_enabled ? PDE_FLAGS | PDE_PAT : PDE_FLAGS);
+}
+
 bool map_window(uintptr_t start_page)
 {
     uintptr_t window = start_page >> (30 - PAGE_SHIFT);
@@ -131,7 +187,7 @@ bool map_window(uintptr_t start_page)
     }
     // Compute the page table entries.
     for (uintptr_t i = 0; i < 512; i++) {
-        pd2[i] = ((uint64_t)window << 30) + (i << VM_PAGE_SHIFT) + 0x83;
+        pd2[i] = ((uint64_t)window << 30) + (i << VM_PAGE_SHIFT) + PDE_FLAGS;
     }
     // Reload the PDBR to flush any remnants of the old mapping.
     load_pdbr();
@@ -34,6 +34,13 @@
  */
 #define VM_WINDOW_SIZE  PAGE_C(1,GB)
 
+/**
+ * If the CPU supports it, programs the page attribute table of the calling
+ * CPU so that regions mapped by map_region_wc() are write-combining. Must be
+ * called on each CPU, before it accesses any such region.
+ */
+void pat_init(void);
+
 /**
  * Maps a physical memory region into the upper 2GB of virtual memory. The
  * virtual address will have the same alignment within a page as the physical
@@ -50,6 +57,21 @@
  */
 uintptr_t map_region(uintptr_t base_addr, size_t size, bool only_for_startup);
 
+/**
+ * As map_region(), but makes the region write-combining if pat_init() has
+ * enabled it, and the region is not in the lower 2GB. Above the region area,
+ * where the mapping is shared, only the 2MB pages the region fully covers are
+ * made write-combining. The region will be permanently mapped. Intended for
+ * the screen frame buffer.
+ *
+ * \param base_addr         - the physical byte address of the region.
+ * \param size              - the region size in bytes.
+ *
+ * \returns
+ * On success, the mapped address in virtual memory, On failure, 0.
+ */
+uintptr_t map_region_wc(uintptr_t base_addr, size_t size);
+
 /**
  * Maps a \ref VM_WINDOW_SIZE region of physical memory into the upper 2GB of
  * virtual memory. The physical memory region must be aligned on a \ref
@@ -16,9 +16,6 @@
 #include <stdbool.h>
 #include <stdint.h>
 
-#include "cpuid.h"
-#include "tsc.h"
-
 #include "display.h"
 #include "error.h"
 #include "test.h"
@@ -30,16 +27,10 @@
 // Public Functions
 //------------------------------------------------------------------------------
 
-int test_mov_inv_random(int my_cpu)
+int test_mov_inv_random(int my_cpu, testword_t seed)
 {
     int ticks = 0;
 
-    testword_t seed;
-    if (cpuid_info.flags.rdtsc) {
-        seed = get_tsc();
-    } else {
-        seed = 1 + pass_num;
-    }
     seed *= 0x87654321;
 
     if (my_cpu == master_cpu) {
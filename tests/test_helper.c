@@ -16,15 +16,77 @@
 #include <stdint.h>
 
 #include "cache.h"
+#include "memsize.h"
 #include "smp.h"
+#include "vmem.h"
 
 #include "barrier.h"
 
 #include "config.h"
 #include "display.h"
+#include "profile.h"
 
 #include "test_helper.h"
 
+//------------------------------------------------------------------------------
+// Private Variables
+//------------------------------------------------------------------------------
+
+static testword_t inject_state = 0x2545f491;
+
+//------------------------------------------------------------------------------
+// Private Functions
+//------------------------------------------------------------------------------
+
+static void flip_bits(testword_t *p, testword_t mask)
+{
+    write_word(p, read_word(p) ^ mask);
+}
+
+static void inject_at_addresses(void)
+{
+    for (int i = 0; i < num_inject_addrs; i++) {
+        uintptr_t page = (uintptr_t)(inject_addr[i] >> PAGE_SHIFT);
+        uintptr_t offset = (uintptr_t)inject_addr[i] & (PAGE_SIZE - sizeof(testword_t));
+        for (int j = 0; j < vm_map_size; j++) {
+            // The segment start may have been moved past the program in the
+            // first window, so check the word itself against the bounds.
+            if (page < page_of(vm_map[j].start) || page > page_of(vm_map[j].end)) {
+                continue;
+            }
+            testword_t *p = (testword_t *)((uintptr_t)first_word_mapping(page) + offset);
+            if (p < vm_map[j].start || p > vm_map[j].end) {
+                continue;
+            }
+            flip_bits(p, (testword_t)inject_mask[i]);
+        }
+    }
+}
+
+static void inject_at_random(void)
+{
+    uintptr_t total_words = 0;
+    for (int i = 0; i < vm_map_size; i++) {
+        total_words += vm_map[i].end - vm_map[i].start + 1;
+    }
+    if (total_words == 0) {
+        return;
+    }
+    for (uint32_t n = 0; n < inject_rate; n++) {
+        inject_state = prsg(inject_state);
+        uintptr_t word = inject_state % total_words;
+        inject_state = prsg(inject_state);
+        int bit = inject_state % TESTWORD_WIDTH;
+
+        int seg = 0;
+        while (word > (uintptr_t)(vm_map[seg].end - vm_map[seg].start)) {
+            word -= vm_map[seg].end - vm_map[seg].start + 1;
+            seg++;
+        }
+        flip_bits(vm_map[seg].start + word, (testword_t)1 << bit);
+    }
+}
+
 //------------------------------------------------------------------------------
 // Public Functions
 //------------------------------------------------------------------------------
@@ -39,6 +101,7 @@ void calculate_chunk(testword_t **start, testword_t **end, int my_cpu, int segme
     if (num_active_cpus == 1) {
         *start = vm_map[segment].start;
         *end   = vm_map[segment].end;
+        profile_bytes(my_cpu, (uintptr_t)(*end) - (uintptr_t)(*start) + sizeof(testword_t));
     } else {
         uintptr_t segment_size = (vm_map[segment].end - vm_map[segment].start + 1) * sizeof(testword_t);
         uintptr_t chunk_size   = round_down(segment_size / num_active_cpus, chunk_align);
@@ -50,6 +113,9 @@ void calculate_chunk(testword_t **start, testword_t **end, int my_cpu, int segme
         if (*end > vm_map[segment].end) {
             *end = vm_map[segment].end;
         }
+        if (*end >= *start) {
+            profile_bytes(my_cpu, (uintptr_t)(*end) - (uintptr_t)(*start) + sizeof(testword_t));
+        }
     }
 }
 
@@ -57,18 +123,28 @@ void flush_caches(int my_cpu)
 {
     if (my_cpu >= 0) {
         bool use_spin_wait = (power_save < POWER_SAVE_HIGH);
+        uint64_t start_time = profile_start();
         if (use_spin_wait) {
             barrier_spin_wait(run_barrier);
         } else {
             barrier_halt_wait(run_barrier);
         }
+        profile_end(my_cpu, PROFILE_RUN_BARRIER, start_time);
         if (my_cpu == master_cpu) {
+            // The caches are flushed between the write and check phases of
+            // each test, so this is where any requested faults are injected.
+            start_time = profile_start();
+            inject_at_addresses();
+            inject_at_random();
             cache_flush();
+            profile_end(my_cpu, PROFILE_CACHE_FLUSH, start_time);
         }
+        start_time = profile_start();
         if (use_spin_wait) {
             barrier_spin_wait(run_barrier);
         } else {
             barrier_halt_wait(run_barrier);
         }
+        profile_end(my_cpu, PROFILE_RUN_BARRIER, start_time);
     }
 }
@@ -90,7 +90,10 @@ void calculate_chunk(testword_t **start, testword_t **end, int my_cpu, int segme
 
 /**
  * Flushes the CPU caches. If SMP is enabled, synchronises the threads before
- * and after issuing the cache flush instruction.
+ * and after issuing the cache flush instruction. If fault injection has been
+ * requested, the master CPU flips the requested bits in the memory currently
+ * mapped for testing before flushing the caches, so tests that never flush
+ * the caches (test 0) never see the injected faults.
  */
 void flush_caches(int my_cpu);
 
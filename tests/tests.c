@@ -18,15 +18,14 @@
 #include "boot.h"
 
 #include "cache.h"
-#include "cpuid.h"
 #include "memsize.h"
-#include "tsc.h"
 #include "vmem.h"
 
 #include "barrier.h"
 
 #include "config.h"
 #include "display.h"
+#include "profile.h"
 #include "test.h"
 
 #include "test_funcs.h"
@@ -74,24 +73,38 @@ int ticks_per_test[NUM_PASS_TYPES][NUM_TEST_PATTERNS];
 // Public Functions
 //------------------------------------------------------------------------------
 
+testword_t cpu_seed(int my_cpu)
+{
+    // A replay may hand the failing address to a different CPU, so it uses
+    // the recorded per-CPU seed as given on every CPU.
+    if (replay_test >= 0) {
+        return test_seed;
+    }
+    return test_seed + (testword_t)(my_cpu + 1) * (testword_t)0x9e3779b97f4a7c15ULL;
+}
+
 #define BARRIER \
     if (my_cpu >= 0) { \
         if (TRACE_BARRIERS) { \
             trace(my_cpu, "Run barrier wait at %s line %i", __FILE__, __LINE__); \
         } \
+        uint64_t barrier_start_time = profile_start(); \
         if (power_save < POWER_SAVE_HIGH) { \
             barrier_spin_wait(run_barrier); \
         } else { \
             barrier_halt_wait(run_barrier); \
         } \
+        profile_end(my_cpu, PROFILE_RUN_BARRIER, barrier_start_time); \
     }
 
 int run_test(int my_cpu, int test, int stage, int iterations)
 {
     if (my_cpu == master_cpu) {
         if (window_num == 0) {
-            // First window, so we need to test all selected lower memory.
-            vm_map[0].start = first_word_mapping(pm_limit_lower);
+            if (!partial_window) {
+                // First window, so we need to test all selected lower memory.
+                vm_map[0].start = first_word_mapping(pm_limit_lower);
+            }
 
             // For USB_WORKAROUND.
             if (vm_map[0].start < (uintptr_t *)0x500) {
@@ -169,12 +182,7 @@ int run_test(int my_cpu, int test, int stage, int iterations)
 
         // Moving inversions, fixed random pattern.
       case 5:
-        if (cpuid_info.flags.rdtsc) {
-            prsg_state = get_tsc();
-        } else {
-            prsg_state = 1 + pass_num;
-        }
-        prsg_state *= 0x12345678;
+        prsg_state = cpu_seed(my_cpu) * 0x12345678;
 
         for (int i = 0; i < iterations; i++) {
             prsg_state = prsg(prsg_state);
@@ -211,19 +219,14 @@ int run_test(int my_cpu, int test, int stage, int iterations)
       case 8:
         for (int i = 0; i < iterations; i++) {
             BARRIER;
-            ticks += test_mov_inv_random(my_cpu);
+            ticks += test_mov_inv_random(my_cpu, cpu_seed(my_cpu) + i);
             BAILOUT;
         }
         break;
 
         // Modulo 20 check, fixed random pattern.
       case 9:
-        if (cpuid_info.flags.rdtsc) {
-            prsg_state = get_tsc();
-        } else {
-            prsg_state = 1 + pass_num;
-        }
-        prsg_state *= 0x87654321;
+        prsg_state = cpu_seed(my_cpu) * 0x87654321;
 
         for (int i = 0; i < iterations; i++) {
             for (int offset = 0; offset < MODULO_N; offset++) {
@@ -251,3 +254,36 @@ int run_test(int my_cpu, int test, int stage, int iterations)
     }
     return ticks;
 }
+
+int test_tick_count(int test, int iterations, int num_windows, int sweep_ticks)
+{
+    // Each sweep over a segment takes one tick for each SPIN_SIZE words (or
+    // part thereof). A moving inversions pass fills the memory and then makes
+    // two sweeps for each iteration.
+    switch (test) {
+      case 0:
+        return 2 * num_windows;
+      case 1:
+      case 2:
+        return 2 * sweep_ticks;
+      case 3:
+        return 2 * (1 + 2 * iterations) * sweep_ticks;
+      case 4:
+        return 16 * (1 + 2 * iterations) * sweep_ticks;
+      case 5:
+        return iterations * (1 + 2 * 2) * sweep_ticks;
+      case 6:
+        return 2 * TESTWORD_WIDTH * (1 + 2 * iterations) * sweep_ticks;
+      case 7:
+        return (2 + iterations) * sweep_ticks;
+      case 8:
+        return iterations * 3 * sweep_ticks;
+      case 9:
+        return iterations * MODULO_N * 2 * (2 + 2) * sweep_ticks;
+      case 10:
+        // The fade delay (one tick per second) is only taken in the first window.
+        return 4 * sweep_ticks + (num_windows > 0 ? 2 * iterations : 0);
+      default:
+        return 0;
+    }
+}
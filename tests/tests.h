@@ -13,6 +13,7 @@
 #include <stdbool.h>
 
 #include "config.h"
+#include "test.h"
 
 #define NUM_TEST_PATTERNS   11
 
@@ -32,6 +33,21 @@ typedef enum { FAST_PASS, FULL_PASS, NUM_PASS_TYPES } pass_type_t;
 extern int ticks_per_pass[NUM_PASS_TYPES];
 extern int ticks_per_test[NUM_PASS_TYPES][NUM_TEST_PATTERNS];
 
+/**
+ * Returns the seed for the random patterns generated by my_cpu in the current
+ * test invocation. Each CPU derives its own seed from test_seed, except when
+ * replaying a failure, when test_seed is taken to be the seed recorded for the
+ * failing CPU and is used by every CPU.
+ */
+testword_t cpu_seed(int my_cpu);
+
 int run_test(int my_cpu, int test, int stage, int iterations);
 
+/**
+ * Returns the number of ticks taken by all the stages of the specified test
+ * with the specified number of iterations, when run over num_windows windows
+ * in which a single sweep over all the memory mapped takes sweep_ticks ticks.
+ */
+int test_tick_count(int test, int iterations, int num_windows, int sweep_ticks);
+
 #endif // TESTS_H